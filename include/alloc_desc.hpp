@@ -13,17 +13,32 @@ namespace cppalloc
 enum class alloc_strategy
 {
   best_fit,
-  best_fit_tree
+  best_fit_tree,
+  tlsf,
+  buddy,
+  btree
 };
 
 enum alloc_option_bits : std::uint32_t
 {
   f_defrag          = 1u << 0u,
   f_dedicated_arena = 1u << 1u,
+  f_pinned          = 1u << 2u,
 };
 
 using alloc_options = std::uint32_t;
 
+//! Limits the work done by a single incremental defragmentation step, the step stops as soon as any one is reached.
+//! A block is only moved if it fits in what is left of `bytes`, except for the first block of a step, which always
+//! moves so that every step makes progress.
+template <typename size_type>
+struct defrag_budget
+{
+  size_type                 bytes  = detail::k_null_sz<size_type>;
+  std::uint32_t             blocks = detail::k_null_32;
+  std::chrono::microseconds time   = std::chrono::microseconds::max();
+};
+
 template <typename size_type>
 struct memory_manager_adapter
 {
@@ -37,8 +52,14 @@ struct memory_manager_adapter
     return id;
   }
 
-  void begin_defragment() {}
-  void end_defragment() {}
+  template <typename allocator>
+  void begin_defragment([[maybe_unused]] allocator& a)
+  {
+  }
+  template <typename allocator>
+  void end_defragment([[maybe_unused]] allocator& a)
+  {
+  }
 
   void remove_arena(cppalloc::uhandle h) {}
   void move_memory([[maybe_unused]] uhandle src_arena, [[maybe_unused]] uhandle dst_arena,
@@ -123,4 +144,43 @@ struct alloc_info
   alloc_info(uhandle iharena, size_type ioffset, ihandle ihalloc) : harena(iharena), offset(ioffset), halloc(ihalloc) {}
 };
 
+//! New location of an allocation after defragmentation, passed to the manager's rebind
+template <typename size_type>
+struct rebind_info
+{
+  uhandle               huser = detail::k_null_sz<uhandle>;
+  alloc_info<size_type> info;
+  rebind_info()               = default;
+  rebind_info(uhandle ihuser, alloc_info<size_type> const& iinfo) : huser(ihuser), info(iinfo) {}
+};
+
+// ███╗---███╗███████╗███╗---███╗-██████╗-██████╗-██╗---██╗-----███╗---███╗-██████╗-██╗---██╗███████╗
+// ████╗-████║██╔════╝████╗-████║██╔═══██╗██╔══██╗╚██╗-██╔╝-----████╗-████║██╔═══██╗██║---██║██╔════╝
+// ██╔████╔██║█████╗--██╔████╔██║██║---██║██████╔╝-╚████╔╝------██╔████╔██║██║---██║██║---██║█████╗--
+// ██║╚██╔╝██║██╔══╝--██║╚██╔╝██║██║---██║██╔══██╗--╚██╔╝-------██║╚██╔╝██║██║---██║╚██╗-██╔╝██╔══╝--
+// ██║-╚═╝-██║███████╗██║-╚═╝-██║╚██████╔╝██║--██║---██║███████╗██║-╚═╝-██║╚██████╔╝-╚████╔╝-███████╗
+// ╚═╝-----╚═╝╚══════╝╚═╝-----╚═╝-╚═════╝-╚═╝--╚═╝---╚═╝╚══════╝╚═╝-----╚═╝-╚═════╝---╚═══╝--╚══════╝
+// --------------------------------------------------------------------------------------------------
+//! A copy the manager performs during defragmentation, arenas are the handles returned by the manager's add_arena
+template <typename size_type>
+struct memory_move
+{
+  size_type from      = 0;
+  size_type to        = 0;
+  size_type size      = 0;
+  uhandle   arena_src = detail::k_null_sz<uhandle>;
+  uhandle   arena_dst = detail::k_null_sz<uhandle>;
+
+  memory_move() = default;
+  memory_move(size_type ifrom, size_type ito, size_type isize, uhandle iarena_src, uhandle iarena_dst)
+      : from(ifrom), to(ito), size(isize), arena_src(iarena_src), arena_dst(iarena_dst)
+  {
+  }
+
+  inline bool is_moved() const
+  {
+    return (from != to || arena_src != arena_dst);
+  }
+};
+
 } // namespace cppalloc
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include <detail/cppalloc_common.hpp>
+
+namespace cppalloc
+{
+
+//! Sizes of the arenas an allocator adds.
+//!
+//! The first arena gets `initial` bytes and every arena added after it `factor` times more, up to `cap`. Each arena
+//! given back steps the size down again by the same factor, so an allocator that went idle restarts small. A policy
+//! made from a single size always adds arenas of that size.
+template <typename size_type>
+class arena_growth
+{
+public:
+  arena_growth() = default;
+  arena_growth(size_type fixed) : arena_growth(fixed, fixed) {}
+  arena_growth(size_type initial, size_type cap, std::uint32_t factor = 2)
+      : initial_(initial), cap_(std::max(initial, cap)), current_(initial), factor_(std::max<std::uint32_t>(factor, 1))
+  {
+  }
+
+  //! Size of the next arena
+  inline size_type current() const
+  {
+    return current_;
+  }
+
+  //! Largest arena size, requests above it are left to the allocator
+  inline size_type cap() const
+  {
+    return cap_;
+  }
+
+  //! Size of a new arena that holds at least `size` bytes, the arenas after it grow
+  inline size_type grow(size_type size)
+  {
+    size_type result = current_;
+    while (result < size && result < cap_)
+      result = next(result);
+    current_ = next(result);
+    return std::max(result, size);
+  }
+
+  //! An arena was given back
+  inline void shrink()
+  {
+    current_ = std::max(initial_, current_ / factor_);
+  }
+
+private:
+  inline size_type next(size_type size) const
+  {
+    return size > cap_ / factor_ ? cap_ : size * factor_;
+  }
+
+  size_type     initial_ = 0;
+  size_type     cap_     = 0;
+  size_type     current_ = 0;
+  std::uint32_t factor_  = 1;
+};
+
+} // namespace cppalloc
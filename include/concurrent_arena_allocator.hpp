@@ -0,0 +1,302 @@
+#pragma once
+#include <arena_allocator.hpp>
+#include <memory>
+#include <mutex>
+
+namespace cppalloc
+{
+namespace detail
+{
+//! Forwards the manager calls of one shard to the user manager, serializing them with a lock shared by all
+//! shards and tagging allocation and arena handles with the shard index.
+template <typename manager_t, typename size_type, std::uint32_t k_shard_bits>
+struct shard_manager
+{
+  manager_t*    target = nullptr;
+  std::mutex*   lock   = nullptr;
+  std::uint32_t shard  = 0;
+
+  inline ihandle encode(ihandle h) const
+  {
+    assert(h == k_null_32 || h < (k_null_32 >> k_shard_bits));
+    return h == k_null_32 ? h : ((h << k_shard_bits) | shard);
+  }
+
+  bool drop_arena(uhandle id)
+  {
+    std::lock_guard<std::mutex> guard(*lock);
+    return target->drop_arena(id);
+  }
+
+  uhandle add_arena(ihandle id, size_type size)
+  {
+    std::lock_guard<std::mutex> guard(*lock);
+    return target->add_arena(encode(id), size);
+  }
+
+  void remove_arena(uhandle h)
+  {
+    std::lock_guard<std::mutex> guard(*lock);
+    target->remove_arena(h);
+  }
+
+  template <typename allocator>
+  void begin_defragment(allocator& a)
+  {
+    std::lock_guard<std::mutex> guard(*lock);
+    target->begin_defragment(a);
+  }
+
+  template <typename allocator>
+  void end_defragment(allocator& a)
+  {
+    std::lock_guard<std::mutex> guard(*lock);
+    target->end_defragment(a);
+  }
+
+  void move_memory(uhandle src_arena, uhandle dst_arena, size_type from, size_type to, size_type size)
+  {
+    std::lock_guard<std::mutex> guard(*lock);
+    target->move_memory(src_arena, dst_arena, from, to, size);
+  }
+
+  template <typename alloc_info>
+  void rebind_alloc(uhandle halloc, alloc_info info)
+  {
+    std::lock_guard<std::mutex> guard(*lock);
+    info.halloc = encode(info.halloc);
+    target->rebind_alloc(halloc, info);
+  }
+
+  // batches take the lock once, they are split again if the user manager does not accept them
+  void move_memory(std::span<memory_move<size_type> const> moves)
+  {
+    std::lock_guard<std::mutex> guard(*lock);
+    if constexpr (requires { target->move_memory(moves); })
+      target->move_memory(moves);
+    else
+    {
+      for (auto const& m : moves)
+        target->move_memory(m.arena_src, m.arena_dst, m.from, m.to, m.size);
+    }
+  }
+
+  void rebind_allocs(std::span<rebind_info<size_type> const> rebinds)
+  {
+    std::lock_guard<std::mutex> guard(*lock);
+    std::vector<rebind_info<size_type>> encoded(rebinds.begin(), rebinds.end());
+    for (auto& r : encoded)
+      r.info.halloc = encode(r.info.halloc);
+    if constexpr (requires { target->rebind_allocs(std::span<rebind_info<size_type> const>(encoded)); })
+      target->rebind_allocs(std::span<rebind_info<size_type> const>(encoded));
+    else
+    {
+      for (auto const& r : encoded)
+        target->rebind_alloc(r.huser, r.info);
+    }
+  }
+};
+} // namespace detail
+
+//! Thread safe arena allocator.
+//!
+//! The bank is split across `k_shard_count` independent arena allocators, each guarded by its own lock. Every thread
+//! is bound to a home shard and only takes the lock of another shard when its home shard has no free block large
+//! enough for a request (before the home shard is grown by a new arena). Freed handles are first collected in a small
+//! per-thread cache and handed back to their shards in batches, so a free usually costs no lock at all.
+//!
+//! The returned ihandle carries the shard index in its lowest `log2(k_shard_count)` bits, which limits a shard to
+//! 2^(32 - log2(k_shard_count)) blocks, or 2^(24 - log2(k_shard_count)) with CPPALLOC_HANDLE_CHECKS since the block
+//! handles already spend 8 bits on their generation. The manager does not need to be thread safe, all calls to it are
+//! serialized, but it must tolerate calls coming from any thread.
+//!
+//! Shards can not be defragmented while other threads may hold cached handles, hence `f_defrag` is ignored.
+template <typename manager_t, typename usize_t = std::size_t, alloc_strategy strategy_v = alloc_strategy::best_fit_tree,
+          bool k_compute_stats_v = false, std::uint32_t k_shard_count = 8>
+class concurrent_arena_allocator
+{
+  static_assert(std::has_single_bit(k_shard_count), "Shard count must be a power of 2");
+
+  static constexpr std::uint32_t k_shard_bits  = std::countr_zero(k_shard_count);
+  static constexpr std::uint32_t k_shard_mask  = k_shard_count - 1;
+  static constexpr std::uint32_t k_cache_slots = 64;
+  static constexpr std::uint32_t k_cache_size  = 32;
+
+  using size_type     = usize_t;
+  using shard_manager = detail::shard_manager<manager_t, size_type, k_shard_bits>;
+  using traits        = detail::arena_allocator_traits<shard_manager, usize_t, strategy_v, k_compute_stats_v>;
+  using shard_alloc   = detail::arena_allocator_impl<traits>;
+
+public:
+  using alloc_info = cppalloc::alloc_info<size_type>;
+  using alloc_desc = cppalloc::alloc_desc<size_type>;
+
+  concurrent_arena_allocator(size_type i_arena_size, manager_t& i_manager) : arena_size(i_arena_size)
+  {
+    shards.reserve(k_shard_count);
+    for (std::uint32_t i = 0; i < k_shard_count; ++i)
+      shards.emplace_back(std::make_unique<shard>(i_arena_size, i_manager, manager_lock, i));
+  }
+
+  ~concurrent_arena_allocator()
+  {
+    flush();
+  }
+
+  concurrent_arena_allocator(concurrent_arena_allocator const&) = delete;
+  concurrent_arena_allocator& operator=(concurrent_arena_allocator const&) = delete;
+
+  //! Allocate, thread safe
+  alloc_info allocate(alloc_desc const& idesc)
+  {
+    alloc_desc desc(idesc.size(), idesc.alignment_mask() + 1, idesc.huser(), idesc.flags() & ~f_defrag);
+
+    std::uint32_t home = home_shard();
+    if (desc.flags() & f_dedicated_arena || desc.adjusted_size() >= arena_size)
+      return allocate_from(home, desc);
+
+    alloc_info info;
+    {
+      std::lock_guard<std::mutex> guard(shards[home]->lock);
+      info = shards[home]->alloc.try_allocate(desc);
+    }
+    if (info.halloc != null())
+      return encode(info, home);
+
+    // steal from other shards that are not busy before growing the home shard
+    for (std::uint32_t i = 1; i < k_shard_count; ++i)
+    {
+      std::uint32_t                id = (home + i) & k_shard_mask;
+      std::unique_lock<std::mutex> guard(shards[id]->lock, std::try_to_lock);
+      if (!guard.owns_lock())
+        continue;
+      info = shards[id]->alloc.try_allocate(desc);
+      if (info.halloc != null())
+        return encode(info, id);
+    }
+
+    return allocate_from(home, desc);
+  }
+
+  //! Deallocate, thread safe
+  void deallocate(ihandle i_address)
+  {
+    auto& slot = cache_slots[thread_index() & (k_cache_slots - 1)];
+    if (slot.busy.test_and_set(std::memory_order_acquire))
+    {
+      // another thread is using this slot, do not wait for it
+      release(&i_address, 1);
+      return;
+    }
+
+    slot.handles[slot.count++] = i_address;
+    if (slot.count == k_cache_size)
+    {
+      release(slot.handles.data(), slot.count);
+      slot.count = 0;
+    }
+    slot.busy.clear(std::memory_order_release);
+  }
+
+  //! Return all cached handles to their shards
+  void flush()
+  {
+    for (auto& slot : cache_slots)
+    {
+      while (slot.busy.test_and_set(std::memory_order_acquire))
+        ;
+      release(slot.handles.data(), slot.count);
+      slot.count = 0;
+      slot.busy.clear(std::memory_order_release);
+    }
+  }
+
+  // null
+  inline static constexpr ihandle null()
+  {
+    return detail::k_null_32;
+  }
+
+  // validate, flushes caches
+  void validate_integrity()
+  {
+    flush();
+    for (auto& s : shards)
+    {
+      std::lock_guard<std::mutex> guard(s->lock);
+      s->alloc.validate_integrity();
+    }
+  }
+
+private:
+  struct alignas(64) shard
+  {
+    std::mutex    lock;
+    shard_manager manager;
+    shard_alloc   alloc;
+
+    shard(size_type i_arena_size, manager_t& i_manager, std::mutex& i_manager_lock, std::uint32_t i_index)
+        : manager{&i_manager, &i_manager_lock, i_index}, alloc(i_arena_size, manager)
+    {
+    }
+  };
+
+  struct alignas(64) cache_slot
+  {
+    std::atomic_flag                  busy  = ATOMIC_FLAG_INIT;
+    std::uint32_t                     count = 0;
+    std::array<ihandle, k_cache_size> handles;
+  };
+
+  inline static std::uint32_t thread_index()
+  {
+    static std::atomic_uint32_t counter = 0;
+    thread_local std::uint32_t  index   = counter.fetch_add(1, std::memory_order_relaxed);
+    return index;
+  }
+
+  inline static std::uint32_t home_shard()
+  {
+    return thread_index() & k_shard_mask;
+  }
+
+  inline static alloc_info encode(alloc_info info, std::uint32_t shard)
+  {
+    if (info.halloc != null())
+    {
+      // shifting in the shard index drops the top bits of the shard's handle, see the class comment for the limit
+      assert(info.halloc < (null() >> k_shard_bits));
+      info.halloc = (info.halloc << k_shard_bits) | shard;
+    }
+    return info;
+  }
+
+  inline alloc_info allocate_from(std::uint32_t id, alloc_desc const& desc)
+  {
+    std::lock_guard<std::mutex> guard(shards[id]->lock);
+    return encode(shards[id]->alloc.allocate(desc), id);
+  }
+
+  // release handles, grouping them by shard so each shard lock is taken once
+  inline void release(ihandle* handles, std::uint32_t count)
+  {
+    std::sort(handles, handles + count, [](ihandle a, ihandle b) {
+      return (a & k_shard_mask) < (b & k_shard_mask);
+    });
+
+    for (std::uint32_t i = 0; i < count;)
+    {
+      std::uint32_t               id = handles[i] & k_shard_mask;
+      std::lock_guard<std::mutex> guard(shards[id]->lock);
+      for (; i < count && (handles[i] & k_shard_mask) == id; ++i)
+        shards[id]->alloc.deallocate(handles[i] >> k_shard_bits);
+    }
+  }
+
+  std::vector<std::unique_ptr<shard>>   shards;
+  std::array<cache_slot, k_cache_slots> cache_slots;
+  std::mutex                            manager_lock;
+  size_type                             arena_size;
+};
+
+} // namespace cppalloc
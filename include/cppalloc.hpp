@@ -1,10 +1,14 @@
 
 #pragma once
 #include "arena_allocator.hpp"
+#include "arena_growth.hpp"
+#include "concurrent_arena_allocator.hpp"
 #include "default_allocator.hpp"
+#include "host_arena_manager.hpp"
 #include "linear_allocator.hpp"
 #include "linear_arena_allocator.hpp"
 #include "linear_stack_allocator.hpp"
+#include "memory_move_executor.hpp"
 #include "pool_allocator.hpp"
 #include "std_allocator_wrapper.hpp"
 #include "std_short_alloc.hpp"
@@ -18,9 +18,11 @@ struct arena
 
   block_list<traits> block_order;
   detail::list_node  order;
-  size_type          size = 0;
-  size_type          free = 0;
-  uhandle            data = detail::k_null_sz<uhandle>;
+  size_type          size   = 0;
+  size_type          free   = 0;
+  // bytes of blocks in use kept by the allocator's front cache
+  size_type          cached = 0;
+  uhandle            data   = detail::k_null_sz<uhandle>;
 };
 
 template <typename traits>
@@ -93,7 +95,7 @@ struct bank_data
   bank_data()
   {
     // blocks 0 is sentinel
-    blocks.emplace();
+    blocks.emplace(detail::k_null_sz<typename traits::size_type>, 0, 0);
   }
 };
 } // namespace cppalloc::detail
\ No newline at end of file
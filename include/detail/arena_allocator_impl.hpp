@@ -1,8 +1,12 @@
 ﻿#pragma once
+#include <arena_growth.hpp>
 #include <bit>
 #include <detail/arena.hpp>
 #include <detail/best_fit_strat.hpp>
+#include <detail/buddy_strat.hpp>
 #include <detail/best_fit_tree_strat.hpp>
+#include <detail/btree_strat.hpp>
+#include <detail/tlsf_strat.hpp>
 
 namespace cppalloc::detail
 {
@@ -25,24 +29,51 @@ struct arena_allocator_traits
 template <bool allow = true>
 struct defrag_stats
 {
-  std::uint32_t total_mem_move_merge = 0;
-  std::uint32_t total_arenas_removed = 0;
+  std::uint32_t total_mem_move_merge  = 0;
+  std::uint32_t total_arenas_removed  = 0;
+  std::uint64_t total_bytes_moved     = 0;
+  std::uint32_t total_blocks_moved    = 0;
+  std::uint64_t total_bytes_reclaimed = 0;
+  std::uint32_t total_arenas_retained = 0;
+  std::uint32_t total_arenas_expired  = 0;
 
-  void report_defrag_mem_move_merge()
+  void report_arena_retained()
   {
-    total_mem_move_merge++;
+    total_arenas_retained++;
   }
 
-  void report_defrag_arenas_removed()
+  void report_arena_expired()
+  {
+    total_arenas_expired++;
+  }
+
+  void report_defrag_mem_move_merge(std::uint32_t count = 1)
+  {
+    total_mem_move_merge += count;
+  }
+
+  void report_defrag_block_moved(std::uint64_t size, std::uint32_t count = 1)
+  {
+    total_blocks_moved += count;
+    total_bytes_moved += size;
+  }
+
+  void report_defrag_arenas_removed(std::uint64_t size)
   {
     total_arenas_removed++;
+    total_bytes_reclaimed += size;
   }
 
   std::string print() const
   {
     std::stringstream ss;
     ss << "Defrag memory move merges: " << total_mem_move_merge << "\n"
-       << "Defrag arenas removed: " << total_arenas_removed;
+       << "Defrag arenas removed: " << total_arenas_removed << "\n"
+       << "Defrag blocks moved: " << total_blocks_moved << "\n"
+       << "Defrag bytes moved: " << total_bytes_moved << "\n"
+       << "Defrag bytes reclaimed: " << total_bytes_reclaimed << "\n"
+       << "Empty arenas retained: " << total_arenas_retained << "\n"
+       << "Retained arenas expired: " << total_arenas_expired;
     return ss.str();
   }
 };
@@ -50,10 +81,15 @@ struct defrag_stats
 template <>
 struct defrag_stats<false>
 {
+  static void report_arena_retained() {}
+
+  static void report_arena_expired() {}
 
-  static void report_defrag_mem_move_merge() {}
+  static void report_defrag_mem_move_merge(std::uint32_t = 1) {}
 
-  static void report_defrag_arenas_removed() {}
+  static void report_defrag_block_moved(std::uint64_t, std::uint32_t = 1) {}
+
+  static void report_defrag_arenas_removed(std::uint64_t) {}
 
   static std::string print()
   {
@@ -75,26 +111,128 @@ class arena_allocator_impl : public detail::statistics<detail::arena_allocator_t
   using statistics     = detail::statistics<detail::arena_allocator_tag<traits::strategy>, traits::k_compute_stats,
                                         defrag_stats<traits::k_compute_stats>>;
   using strategy       = detail::alloc_strategy_type<traits>;
-  using memory_move    = detail::memory_move<traits>;
   using alloc_desc     = cppalloc::alloc_desc<size_type>;
   using arena_manager  = typename traits::manager;
   using bank_data      = detail::bank_data<traits>;
 
+  // strategies that keep their free space without blocks, blocks exist only for allocations and are released to the
+  // strategy, which sizes requests on its own, see alloc_strategy::buddy
+  static constexpr bool k_strategy_coalesces = requires(strategy& s, bank_data& b, std::uint32_t node) {
+    s.coalesce(b, node);
+  };
+
+  // strategies that list the next fitting block after a candidate let allocate prefer fuller arenas, see find_free
+  static constexpr bool k_strategy_iterates = requires(strategy& s, bank_data& b, size_type size) {
+    s.try_allocate(b, size, s.try_allocate(b, size));
+  };
+
+  // strategies that take and give back many free blocks in one pass, see release_merged
+  static constexpr bool k_strategy_batches = requires(strategy& s, block_bank& b, std::span<std::uint32_t> nodes) {
+    s.erase(b, nodes);
+    s.add_free(b, nodes);
+  };
+
+  //! Bytes reserved for a request, the padding in front of an aligned offset is added once a free block is chosen
+  static inline size_type request_size(alloc_desc const& desc)
+  {
+    if constexpr (requires { strategy::request_size(desc); })
+      return strategy::request_size(desc);
+    else
+      return std::max<size_type>(desc.size(), 1);
+  }
+
+  //! Size of a new arena for a request that fits nowhere else, strategies that do not search every free block large
+  //! enough may need more, see alloc_strategy::tlsf
+  static inline size_type arena_fit_size(size_type size)
+  {
+    if constexpr (requires { strategy::fit_size(size); })
+      return strategy::fit_size(size);
+    else
+      return size;
+  }
+
+  static inline size_type align(size_type offset, size_type alignment_mask)
+  {
+    return (offset + alignment_mask) & ~alignment_mask;
+  }
+
 public:
-  using alloc_info   = cppalloc::alloc_info<size_type>;
-  using option_flags = std::uint32_t;
+  using alloc_info    = cppalloc::alloc_info<size_type>;
+  using option_flags  = std::uint32_t;
+  using defrag_budget = cppalloc::defrag_budget<size_type>;
+  using memory_move   = cppalloc::memory_move<size_type>;
+  using rebind_info   = cppalloc::rebind_info<size_type>;
+  using arena_growth  = cppalloc::arena_growth<size_type>;
+
+  //! Managers may accept all moves and all rebinds of a defragmentation at once, with
+  //! `move_memory(std::span<memory_move const>)` and `rebind_allocs(std::span<rebind_info const>)`. Moves between
+  //! the same pair of arenas are adjacent in the batch, a manager may use those runs or ignore them.
+  static constexpr bool k_batch_moves = requires(arena_manager& m, std::span<memory_move const> s) {
+    m.move_memory(s);
+  };
+  static constexpr bool k_batch_rebinds = requires(arena_manager& m, std::span<rebind_info const> s) {
+    m.rebind_allocs(s);
+  };
+
+  //! Result of a defragmentation dry run, see plan_defragment
+  class defrag_plan
+  {
+  public:
+    //! Memory moves in the order they must be performed, moves between the same pair of arenas are adjacent
+    std::vector<memory_move> moves;
+    //! Total bytes the moves copy
+    size_type                bytes_to_move   = 0;
+    //! Arenas the plan removes and the bytes they hold
+    std::uint32_t            arenas_freed    = 0;
+    size_type                bytes_reclaimed = 0;
+    //! Fragmentation of the free space once the plan is applied, see fragmentation()
+    float                    fragmentation   = 0.0f;
+
+  private:
+    friend class arena_allocator_impl;
+
+    bank_data                  bank;
+    std::vector<rebind_info>   rebinds;
+    std::vector<std::uint32_t> deleted_arenas;
+    std::uint32_t              move_merges  = 0;
+    std::uint32_t              blocks_moved = 0;
+    std::uint64_t              generation   = 0;
+  };
 
   template <typename... Args>
   inline arena_allocator_impl(size_type i_arena_size, arena_manager& i_manager, Args&&... args);
   //! Allocate
   alloc_info allocate(alloc_desc const& desc);
-  //! Deallocate, size is optional
+  //! Allocate only from free blocks of existing arenas, returns a null alloc_info instead of adding an arena or
+  //! defragmenting
+  alloc_info try_allocate(alloc_desc const& desc);
+  //! Deallocate, size is optional. With CPPALLOC_HANDLE_CHECKS the handles taken by the allocator are checked, one
+  //! whose allocation was deallocated, moved or rebound by a defragmentation since is reported through
+  //! CPPALLOC_STALE_HANDLE.
   void deallocate(ihandle i_address);
+  //! Allocate a batch, `infos[i]` receives the allocation of `descs[i]`. Requests are sorted by size and packed
+  //! together into the free blocks that can hold several of them, which takes one lookup and one split per free block.
+  void allocate(std::span<alloc_desc const> descs, std::span<alloc_info> infos);
+  //! Deallocate a batch, allocations that are next to each other in an arena are released together
+  void deallocate(std::span<ihandle const> i_addresses);
+  //! Grow an allocation to `new_size` bytes in place, over the free blocks that follow it in its arena. Returns false
+  //! and leaves the allocation untouched if they are too small, or if it would outgrow its block with the buddy
+  //! strategy.
+  bool try_expand(ihandle i_address, size_type new_size);
+  //! Give the end of an allocation past `new_size` bytes back to the free blocks, the buddy strategy keeps the block
+  void shrink(ihandle i_address, size_type new_size);
 
   // set default arena size
   inline void set_arena_size(size_type isz)
   {
-    arena_size = isz;
+    growth = arena_growth(isz);
+  }
+
+  //! Sizes of the arenas added from now on, allocations of at least `policy.cap()` bytes get a dedicated arena. Arenas
+  //! dropped by the allocator shrink the next ones.
+  inline void set_arena_growth(arena_growth const& policy)
+  {
+    growth = policy;
   }
 
   // null
@@ -103,6 +241,111 @@ public:
     return detail::k_null_32;
   }
 
+  //! Incremental defragmentation, moves blocks until the budget is exhausted and resumes from there on the next call.
+  //! Live blocks are first slid left inside each arena, then the remaining hole at the end of an arena is filled with
+  //! blocks pulled from the last arenas, so those empty out and are dropped. The allocator stays usable between steps.
+  //! Returns true when a complete pass over all arenas has finished. The buddy strategy has nothing to do here, it
+  //! always returns true.
+  bool defragment_step(defrag_budget const& budget);
+
+  //! Dry run of a full defragmentation. The allocator is not modified, the returned plan describes the memory moves
+  //! and what they would achieve so the caller can decide if it is worth applying. Buddy blocks keep their place in
+  //! an arena, the plan empties the sparsest arenas, as many as the others have room for.
+  defrag_plan plan_defragment() const;
+  //! Dry run of a minimal movement defragmentation. Only arenas filled below `max_occupancy` (0 to 1) are evacuated,
+  //! sparsest first, into the holes of the other arenas. Arenas that are not evacuated are left untouched.
+  defrag_plan plan_evacuation(float max_occupancy) const;
+  //! Perform a plan returned by plan_defragment. Returns false and does nothing if the allocator was modified since
+  //! the plan was made.
+  bool apply_plan(defrag_plan&& plan);
+
+  //! Arenas filled below this are evacuated when an f_defrag allocation triggers a defragmentation, at 1 (default)
+  //! all arenas are repacked
+  inline void set_defrag_occupancy(float max_occupancy)
+  {
+    defrag_occupancy = max_occupancy;
+  }
+
+  //! Arenas that become empty are kept, up to `max_empty` of them, instead of being handed back to the manager with
+  //! drop_arena, so the next allocations reuse them. A kept arena is dropped once `max_allocations` allocations went
+  //! by without using it, or when a newer one takes its place. Dedicated arenas above the growth cap are not kept. At
+  //! 0 (default) empty arenas are dropped right away.
+  inline void set_arena_retention(std::uint32_t max_empty, std::uint64_t max_allocations = detail::k_null_64)
+  {
+    max_retained       = max_empty;
+    retain_allocations = max_allocations;
+    while (retained_arenas.size() > max_retained)
+      expire_arena();
+  }
+
+  //! Of the first `count` free blocks that fit an allocation, at most 1/32 larger than the best fit, the one in the
+  //! fullest arena is taken, so lightly used arenas drain and are dropped. At 1 (default) the strategy's choice is
+  //! kept. Only used by strategies that can list fitting blocks in order (best_fit, best_fit_tree, btree).
+  inline void set_placement_candidates(std::uint32_t count)
+  {
+    placement_candidates = std::max<std::uint32_t>(count, 1);
+  }
+
+  //! Released blocks of at most `max_size` bytes are kept aside, up to `max_blocks` of them, and handed back whole to
+  //! the next allocation of the same size whose alignment their offset meets, without searching or splitting free
+  //! blocks. Cached blocks still count as allocated. They go back to the free blocks when an allocation does not fit
+  //! otherwise, before a defragmentation and when the limits change, and the cached blocks of an arena go back with
+  //! the last block in use of it so the arena can be dropped. At 0 (default) blocks are released right away.
+  inline void set_front_cache(std::uint32_t max_blocks, size_type max_size = 256)
+  {
+    flush_cache();
+    max_cached_blocks = max_blocks;
+    cache_heads.assign(max_blocks ? static_cast<std::size_t>(max_size) + 1 : 0, detail::k_null_32);
+  }
+
+  //! Deallocated blocks are queued instead of merged with their free neighbours one at a time. The queue is sorted and
+  //! released as a batch, neighbours joined first like a batch deallocate, once it holds `max_blocks`, when an
+  //! allocation does not fit otherwise, before a defragmentation and when the limit changes. Queued blocks still
+  //! count as allocated, an arena they empty is only dropped with the batch. Strategies that merge a batch into their
+  //! free blocks in one pass (best_fit) gain the most. At 0 (default) blocks are released right away.
+  inline void set_deferred_release(std::uint32_t max_blocks)
+  {
+    flush_deferred();
+    max_deferred = max_blocks;
+    deferred.reserve(max_blocks);
+  }
+
+  //! Blocks are stored in pages that are never moved, room for `count` of them can be made ahead of a burst
+  inline void reserve_blocks(std::uint32_t count)
+  {
+    bank.blocks.reserve(count);
+  }
+
+  //! Frees the block pages after the last one in use
+  inline void shrink_to_fit()
+  {
+    bank.blocks.shrink_to_fit();
+  }
+
+  //! Pinned blocks are never moved by defragmentation, allocations made with f_pinned start pinned
+  inline void pin(ihandle i_address)
+  {
+    bank.blocks[bank.blocks.index(i_address)].is_pinned = true;
+    generation++;
+  }
+
+  inline void unpin(ihandle i_address)
+  {
+    bank.blocks[bank.blocks.index(i_address)].is_pinned = false;
+    generation++;
+  }
+
+  inline bool is_pinned(ihandle i_address) const
+  {
+    return bank.blocks[bank.blocks.index(i_address)].is_pinned;
+  }
+
+  //! Fragmentation of the free space between 0 and 1, the share of free memory not in the largest free block
+  float fragmentation() const
+  {
+    return fragmentation(bank);
+  }
+
   // validate
   void validate_integrity();
 
@@ -111,332 +354,1708 @@ private:
   inline static std::pair<ihandle, ihandle> add_arena(bank_data& ibank, uhandle ihandle, size_type iarena_size,
                                                       bool empty);
 
-  void               defragment();
-  inline size_type   finalize_commit(block& blk, uhandle huser, size_type alignment);
-  inline static void copy(block const& src, block& dst);
-  inline void        push_memmove(std::vector<memory_move>& dst, memory_move value);
+  void                        defragment();
+  inline bool                 retain_arena(std::uint32_t arena_id);
+  inline void                 expire_arena();
+  inline void                 expire_arenas();
+  inline bool                 drop_arena(std::uint32_t arena_id);
+  inline auto                 find_free(size_type size, size_type alignment_mask);
+  inline static auto          find_aligned(bank_data& ibank, size_type size, size_type alignment_mask);
+  template <typename iterator>
+  inline static std::uint32_t commit_aligned(bank_data& ibank, size_type size, size_type alignment_mask,
+                                             iterator found, bool keep_padding = false);
+  inline alloc_info           allocate_block(alloc_desc const& desc, size_type size);
+  inline void                 allocate_runs(std::span<alloc_desc const> descs, std::span<alloc_info> infos);
+  inline size_type            finalize_commit(std::uint32_t node, alloc_desc const& desc);
+  inline size_type            assign(std::uint32_t node, alloc_desc const& desc);
+  inline static void          copy(block_bank const& src, std::uint32_t src_node, block_bank& dst,
+                                   std::uint32_t dst_node);
+  inline static bool          push_memmove(std::vector<memory_move>& dst, memory_move value);
+  inline static std::uint32_t group_moves(std::vector<memory_move>& moves);
+  inline static void          plan_move(defrag_plan& plan, bank_data const& src, std::uint32_t blk_id,
+                                        std::uint32_t new_blk_id);
+  inline static std::uint32_t carve(bank_data& ibank, std::uint32_t arena_id, size_type offset, size_type size);
+  inline static void          release_range(bank_data& ibank, std::uint32_t arena_id, size_type offset, size_type end);
+  inline static float         fragmentation(bank_data const& ibank);
+  inline defrag_plan          plan_compaction() const;
+  inline defrag_plan          plan_evacuation(bank_data const& src, std::vector<std::uint32_t> const& sparse) const;
+  inline bool                 compact_step(defrag_budget const& budget);
+  inline std::uint32_t        next_pinned(std::uint32_t blk_id) const;
+  inline void                 release(ihandle node);
+  inline void                 release_sorted(std::vector<ihandle>& nodes);
+  inline void                 release_merged(std::vector<ihandle>& runs);
+  inline static void          merge_free(bank_data& ibank, std::uint32_t node);
+  inline bool                 cache(ihandle node);
+  inline std::uint32_t        take_cached(size_type size, size_type alignment_mask);
+  inline void                 flush_cache();
+  inline void                 flush_cache(std::uint32_t arena_id);
+  inline void                 flush_deferred();
+  inline bool                 flush_held();
+  inline bank_data const&     without_held(bank_data& scratch) const;
+
+  //! Arenas without pinned blocks, sparsest first
+  inline std::vector<std::uint32_t> by_occupancy(bank_data const& src) const;
+
+  inline void slide_block(std::uint32_t hole, std::uint32_t node);
+  inline void pull_block(std::uint32_t& hole, std::uint32_t node);
+  inline void notify_move(std::uint32_t node, std::uint32_t src_arena, std::pair<size_type, size_type> src);
+  inline void dispatch(std::span<memory_move const> moves, std::span<rebind_info const> rebinds);
+  inline void flush_moves();
 
-  bank_data      bank;
-  arena_manager& manager;
-  size_type      arena_size;
+  bank_data                  bank;
+  arena_manager&             manager;
+  arena_growth               growth;
+  // arena being compacted by defragment_step
+  std::uint32_t              defrag_cursor        = detail::k_null_32;
+  // changes on every modification of bank, invalidates plans
+  std::uint64_t              generation           = 0;
+  float                      defrag_occupancy     = 1.0f;
+  std::uint32_t              placement_candidates = 1;
+  // empty arenas kept from being dropped, oldest first, with the allocation count when they became empty
+  std::vector<std::pair<std::uint32_t, std::uint64_t>> retained_arenas;
+  std::uint32_t                                        max_retained       = 0;
+  std::uint64_t                                        retain_allocations = detail::k_null_64;
+  std::uint64_t                                        allocations        = 0;
+  // scratch space of the batch allocate and deallocate
+  std::vector<std::pair<size_type, std::uint32_t>>     batch_order;
+  std::vector<ihandle>                                 batch_handles;
+  std::vector<std::uint32_t>                           batch_blocks;
+  // released blocks kept by size, each list is linked through the user data of its blocks, see set_front_cache
+  std::vector<std::uint32_t>                           cache_heads;
+  std::uint32_t                                        cached_blocks     = 0;
+  std::uint32_t                                        max_cached_blocks = 0;
+  // deallocated blocks waiting to be released as a batch, see set_deferred_release
+  std::vector<ihandle>                                 deferred;
+  std::uint32_t                                        max_deferred = 0;
+  // moves of the current defragment_step, and the blocks to release once they are done
+  std::vector<memory_move>   pending_moves;
+  std::vector<rebind_info>   pending_rebinds;
+  std::vector<std::uint32_t> pending_releases;
 };
 
 template <typename traits>
 template <typename... Args>
 inline arena_allocator_impl<traits>::arena_allocator_impl(size_type i_arena_size, arena_manager& i_manager,
                                                           Args&&... i_args)
-    : statistics(std::forward<Args>(i_args)...), manager(i_manager), arena_size(i_arena_size)
+    : statistics(std::forward<Args>(i_args)...), manager(i_manager), growth(i_arena_size)
 {
 }
 
 template <typename traits>
-inline typename arena_allocator_impl<traits>::alloc_info arena_allocator_impl<traits>::allocate(alloc_desc const& desc)
+inline auto arena_allocator_impl<traits>::find_aligned(bank_data& ibank, size_type size, size_type alignment_mask)
 {
-  auto measure = this->statistics::report_allocate(desc.size());
-  auto size    = desc.adjusted_size();
-
-  assert(desc.huser() != detail::k_null_uh);
-  if (desc.flags() & f_dedicated_arena || size >= arena_size)
+  auto found = ibank.strat.try_allocate(ibank, size);
+  // buddy pieces sit at offsets aligned to their size, see its request_size
+  if constexpr (!k_strategy_coalesces)
   {
-    auto ret = add_arena(desc.huser(), size, false);
-    return alloc_info(bank.arenas[ret.first].data, 0, ret.second);
-  }
+    auto fits = [&](auto it) {
+      auto const& blk = ibank.blocks[ibank.strat.node(it)];
+      return align(blk.offset, alignment_mask) - blk.offset + size <= blk.size;
+    };
 
-  std::uint32_t id = bank.strat.commit(bank, size, bank.strat.try_allocate(bank, size));
-  if (id == null())
-  {
-    if (desc.flags() & f_defrag)
+    if constexpr (k_strategy_iterates)
     {
-      defragment();
-      id = bank.strat.commit(bank, size, bank.strat.try_allocate(bank, size));
+      // a few close candidates are tried, past them any block of size + alignment_mask fits
+      constexpr std::uint32_t k_aligned_candidates = 8;
+      for (std::uint32_t n = 0; ibank.strat.is_valid(found) && !fits(found); ++n)
+        found = n < k_aligned_candidates ? ibank.strat.try_allocate(ibank, size, found)
+                                         : ibank.strat.try_allocate(ibank, size + alignment_mask);
     }
+    else if (ibank.strat.is_valid(found) && !fits(found))
+      found = ibank.strat.try_allocate(ibank, size + alignment_mask);
+  }
+  return found;
+}
 
-    if (id == null())
+template <typename traits>
+template <typename iterator>
+inline std::uint32_t arena_allocator_impl<traits>::commit_aligned(bank_data& ibank, size_type size,
+                                                                  size_type alignment_mask, iterator found,
+                                                                  bool keep_padding)
+{
+  if constexpr (k_strategy_coalesces)
+    return ibank.strat.commit(ibank, size, found);
+  else
+  {
+    if (!ibank.strat.is_valid(found))
+      return k_null_32;
+
+    auto offset  = ibank.blocks[ibank.strat.node(found)].offset;
+    auto padding = align(offset, alignment_mask) - offset;
+    auto id      = ibank.strat.commit(ibank, padding + size, found);
+    if (padding && !keep_padding)
     {
-      add_arena(detail::k_null_sz<uhandle>, arena_size, true);
-      id = bank.strat.commit(bank, size, bank.strat.try_allocate(bank, size));
+      // the padding goes back as a free block of its own, it merges again once a neighbour is released
+      auto arena = ibank.blocks[id].arena;
+      auto lead  = ibank.blocks.emplace(offset, padding, arena, detail::k_null_sz<uhandle>, true);
+      ibank.blocks[id].offset += padding;
+      ibank.blocks[id].size -= padding;
+      ibank.arenas[arena].block_order.insert(ibank.blocks, id, lead);
+      ibank.strat.add_free(ibank.blocks, lead);
     }
+    return id;
   }
-
-  if (id == null())
-    return alloc_info();
-  auto& blk = bank.blocks[id];
-  return alloc_info(bank.arenas[blk.arena].data, finalize_commit(blk, desc.huser(), desc.alignment_mask()), id);
 }
 
 template <typename traits>
-inline void arena_allocator_impl<traits>::deallocate(ihandle node)
+inline auto arena_allocator_impl<traits>::find_free(size_type size, size_type alignment_mask)
 {
-  auto& blk     = bank.blocks[node];
-  auto  measure = this->statistics::report_deallocate(blk.size);
-
-  enum
+  auto found = find_aligned(bank, size, alignment_mask);
+  if constexpr (k_strategy_iterates)
   {
-    f_left  = 1 << 0,
-    f_right = 1 << 1,
-  };
+    if (placement_candidates == 1 || !bank.strat.is_valid(found))
+      return found;
 
-  enum merge_type
-  {
-    e_none,
-    e_left,
-    e_right,
-    e_left_and_right
-  };
+    auto occupancy = [this](auto it) {
+      auto const& arena = bank.arenas[bank.blocks[bank.strat.node(it)].arena];
+      return static_cast<float>(arena.size - arena.free) / static_cast<float>(arena.size);
+    };
 
-  auto& arena     = bank.arenas[blk.arena];
-  auto& node_list = arena.block_order;
+    auto      best          = found;
+    float     best_occupied = occupancy(found);
+    size_type limit         = bank.blocks[bank.strat.node(found)].size;
+    // wider choices split larger blocks and cost more than the draining gains
+    limit += limit / 32;
+    for (std::uint32_t n = 1; n < placement_candidates; ++n)
+    {
+      found = bank.strat.try_allocate(bank, size, found);
+      if (!bank.strat.is_valid(found) || bank.blocks[bank.strat.node(found)].size > limit)
+        break;
+      auto const& blk = bank.blocks[bank.strat.node(found)];
+      if (align(blk.offset, alignment_mask) - blk.offset + size > blk.size)
+        continue;
+      float occupied = occupancy(found);
+      if (occupied > best_occupied)
+      {
+        best          = found;
+        best_occupied = occupied;
+      }
+    }
+    return best;
+  }
+  else
+    return found;
+}
 
-  // last index is not used
-  bank.free_size += blk.size;
-  arena.free += blk.size;
-  auto size = blk.size;
+template <typename traits>
+inline typename arena_allocator_impl<traits>::alloc_info arena_allocator_impl<traits>::allocate(alloc_desc const& desc)
+{
+  auto measure = this->statistics::report_allocate(desc.size());
+  generation++;
+  allocations++;
+  if (!retained_arenas.empty())
+    expire_arenas();
+  return allocate_block(desc, request_size(desc));
+}
 
-  std::uint32_t left = detail::k_null_32, right = detail::k_null_32;
-  std::uint32_t merges = 0;
+template <typename traits>
+inline void arena_allocator_impl<traits>::allocate(std::span<alloc_desc const> descs, std::span<alloc_info> infos)
+{
+  assert(infos.size() >= descs.size());
+  std::size_t total = 0;
+  for (auto const& desc : descs)
+    total += desc.size();
+  auto measure = this->statistics::report_allocate(total, static_cast<std::uint32_t>(descs.size()));
+  generation++;
+  allocations += descs.size();
+  if (!retained_arenas.empty())
+    expire_arenas();
 
-  if (node != node_list.front() && bank.blocks[blk.arena_order.prev].is_free)
+  // buddy blocks must stay powers of two and cannot share a free block, and a tlsf lookup for the sum of a run
+  // lands in a larger class than the requests would, so only strategies that search their free blocks carve runs
+  if constexpr (!k_strategy_iterates)
   {
-    left = blk.arena_order.prev;
-    merges |= f_left;
+    for (std::size_t i = 0; i < descs.size(); ++i)
+      infos[i] = allocate_block(descs[i], request_size(descs[i]));
   }
+  else
+    allocate_runs(descs, infos);
+}
 
-  if (node != node_list.back() && bank.blocks[blk.arena_order.next].is_free)
+template <typename traits>
+inline void arena_allocator_impl<traits>::allocate_runs(std::span<alloc_desc const> descs, std::span<alloc_info> infos)
+{
+  // largest first, so runs of requests are carved from as few free blocks as possible
+  auto& order = batch_order;
+  order.clear();
+  size_type remaining = 0;
+  for (std::uint32_t i = 0; i < descs.size(); ++i)
   {
-    right = blk.arena_order.next;
-    merges |= f_right;
+    auto size = request_size(descs[i]);
+    if (descs[i].flags() & f_dedicated_arena || size >= growth.cap())
+      infos[i] = allocate_block(descs[i], size);
+    else
+    {
+      order.emplace_back(size, i);
+      remaining += size + descs[i].alignment_mask();
+    }
   }
+  std::sort(order.begin(), order.end(), std::greater<>());
 
-  if (arena.free == arena.size && manager.drop_arena(arena.data))
+  // a block for all that remains is looked for once, and again only after an arena was added
+  bool whole = true;
+  for (std::size_t first = 0; first < order.size();)
   {
-    // drop arena?
-    if (left != k_null_32)
-      bank.strat.erase(bank.blocks, left);
-    if (right != k_null_32)
-      bank.strat.erase(bank.blocks, right);
+    auto mask  = descs[order[first].second].alignment_mask();
+    auto found = whole ? find_free(remaining, 0) : find_free(order[first].first, mask);
+    if (whole && !bank.strat.is_valid(found))
+    {
+      whole = false;
+      found = find_free(order[first].first, mask);
+    }
+    if (!bank.strat.is_valid(found))
+    {
+      // not even the largest request fits, it adds an arena like a single allocation would
+      auto index   = order[first].second;
+      infos[index] = allocate_block(descs[index], order[first].first);
+      remaining -= order[first++].first + mask;
+      whole = true;
+      continue;
+    }
 
-    std::uint32_t arena_id = blk.arena;
-    bank.free_size -= arena.size;
-    arena.size = 0;
-    arena.block_order.clear(bank.blocks);
-    bank.arena_order.erase(bank.arenas, arena_id);
-    return;
-  }
+    // as many of the next requests as the block holds, the padding of each stays in front of it
+    auto const& free_blk = bank.blocks[bank.strat.node(found)];
+    size_type   start    = free_blk.offset;
+    size_type   cursor   = start;
+    auto        last     = first;
+    for (; last < order.size(); ++last)
+    {
+      auto next = align(cursor, descs[order[last].second].alignment_mask()) + order[last].first;
+      if (next > start + free_blk.size)
+        break;
+      cursor = next;
+    }
 
-  switch (merges)
-  {
-  case merge_type::e_none:
-    bank.strat.add_free(bank.blocks, node);
-    blk.is_free = true;
-    break;
-  case merge_type::e_left:
-    bank.strat.replace(bank.blocks, left, left, bank.blocks[left].size + size);
-    node_list.erase(bank.blocks, node);
-    break;
-  case merge_type::e_right:
-    bank.strat.replace(bank.blocks, right, node, bank.blocks[right].size + size);
-    node_list.erase(bank.blocks, right);
-    blk.is_free = true;
-    break;
-  case merge_type::e_left_and_right:
-    bank.strat.erase(bank.blocks, right);
-    bank.strat.replace(bank.blocks, left, left, bank.blocks[left].size + bank.blocks[right].size + size);
-    node_list.erase2(bank.blocks, node);
+    auto id = bank.strat.commit(bank, cursor - start, found);
+    for (; first < last; ++first)
+    {
+      auto index = order[first].second;
+      auto piece = id;
+      remaining -= order[first].first + descs[index].alignment_mask();
+      if (first + 1 < last)
+      {
+        auto arena  = bank.blocks[id].arena;
+        auto offset = bank.blocks[id].offset;
+        auto size   = align(offset, descs[index].alignment_mask()) - offset + order[first].first;
+        auto rest   = bank.blocks[id].size - size;
+        id          = bank.blocks.emplace(offset + size, rest, arena);
+
+        bank.blocks[piece].size = size;
+        bank.arenas[arena].block_order.insert_after(bank.blocks, piece, id);
+      }
+      auto harena  = bank.arenas[bank.blocks[piece].arena].data;
+      infos[index] = alloc_info(harena, finalize_commit(piece, descs[index]), bank.blocks.handle(piece));
+    }
   }
 }
 
 template <typename traits>
-inline void arena_allocator_impl<traits>::validate_integrity()
+inline typename arena_allocator_impl<traits>::alloc_info arena_allocator_impl<traits>::allocate_block(
+    alloc_desc const& desc, size_type size)
 {
-  std::uint32_t total_free_nodes = 0;
-  for (auto arena_it = bank.arena_order.begin(bank.arenas), arena_end_it = bank.arena_order.end(bank.arenas);
-       arena_it != arena_end_it; ++arena_it)
+  assert(desc.huser() != detail::k_null_uh);
+  if (desc.flags() & f_dedicated_arena || size >= growth.cap())
   {
-    auto& arena           = *arena_it;
-    bool  arena_allocated = false;
-
-    for (auto blk_it = arena.block_order.begin(bank.blocks), blk_end_it = arena.block_order.end(bank.blocks);
-         blk_it != blk_end_it; ++blk_it)
-    {
-      auto& blk = *blk_it;
-      if ((blk.is_free))
-        total_free_nodes++;
-    }
+    auto ret                          = add_arena(desc.huser(), size, false);
+    bank.blocks[ret.second].is_pinned = (desc.flags() & f_pinned) != 0;
+    return alloc_info(bank.arenas[ret.first].data, 0, bank.blocks.handle(ret.second));
   }
 
-  assert(total_free_nodes == bank.strat.total_free_nodes(bank.blocks));
-  assert(bank.strat.total_free_size(bank.blocks) == bank.free_size);
+  auto          mask = desc.alignment_mask();
+  std::uint32_t id   = take_cached(size, mask);
+  if (id != null())
+    return alloc_info(bank.arenas[bank.blocks[id].arena].data, assign(id, desc), bank.blocks.handle(id));
 
-  for (auto arena_it = bank.arena_order.begin(bank.arenas), arena_end_it = bank.arena_order.end(bank.arenas);
-       arena_it != arena_end_it; ++arena_it)
+  id = commit_aligned(bank, size, mask, find_free(size, mask));
+  if (id == null() && flush_held())
+    id = commit_aligned(bank, size, mask, find_free(size, mask));
+
+  if (id == null())
   {
-    auto&     arena           = *arena_it;
-    bool      arena_allocated = false;
-    size_type expected_offset = 0;
+    if (desc.flags() & f_defrag)
+    {
+      defragment();
+      id = commit_aligned(bank, size, mask, find_free(size, mask));
+    }
 
-    for (auto blk_it = arena.block_order.begin(bank.blocks), blk_end_it = arena.block_order.end(bank.blocks);
-         blk_it != blk_end_it; ++blk_it)
+    if (id == null())
     {
-      auto& blk = *blk_it;
-      assert(blk.offset == expected_offset);
-      expected_offset += blk.size;
+      // a new arena starts aligned
+      add_arena(detail::k_null_sz<uhandle>, growth.grow(arena_fit_size(size)), true);
+      id = commit_aligned(bank, size, mask, find_free(size, mask));
     }
   }
 
-  bank.strat.validate_integrity(bank.blocks);
+  if (id == null())
+    return alloc_info();
+  return alloc_info(bank.arenas[bank.blocks[id].arena].data, finalize_commit(id, desc), bank.blocks.handle(id));
 }
 
 template <typename traits>
-inline std::pair<ihandle, ihandle> arena_allocator_impl<traits>::add_arena(uhandle ihandle, size_type iarena_size,
-                                                                           bool empty)
+inline typename arena_allocator_impl<traits>::alloc_info arena_allocator_impl<traits>::try_allocate(
+    alloc_desc const& desc)
 {
-  this->statistics::report_new_arena();
-  auto ret                    = add_arena(bank, ihandle, iarena_size, empty);
-  bank.arenas[ret.first].data = manager.add_arena(ret.first, iarena_size);
-  return ret;
+  auto size = request_size(desc);
+  if (desc.flags() & f_dedicated_arena || size >= growth.cap())
+    return alloc_info();
+
+  allocations++;
+  if (!retained_arenas.empty())
+    expire_arenas();
+
+  auto          mask = desc.alignment_mask();
+  std::uint32_t id   = take_cached(size, mask);
+  if (id != null())
+  {
+    generation++;
+    auto measure = this->statistics::report_allocate(desc.size());
+    return alloc_info(bank.arenas[bank.blocks[id].arena].data, assign(id, desc), bank.blocks.handle(id));
+  }
+
+  id = commit_aligned(bank, size, mask, find_free(size, mask));
+  if (id == null() && flush_held())
+    id = commit_aligned(bank, size, mask, find_free(size, mask));
+  if (id == null())
+    return alloc_info();
+
+  generation++;
+  auto measure = this->statistics::report_allocate(desc.size());
+  return alloc_info(bank.arenas[bank.blocks[id].arena].data, finalize_commit(id, desc), bank.blocks.handle(id));
 }
 
 template <typename traits>
-inline std::pair<ihandle, ihandle> arena_allocator_impl<traits>::add_arena(bank_data& ibank, uhandle ihandle,
-                                                                           size_type iarena_size, bool iempty)
+inline void arena_allocator_impl<traits>::deallocate(ihandle handle)
 {
-
-  std::uint32_t arena_id  = ibank.arenas.emplace();
-  auto&         arena_ref = ibank.arenas[arena_id];
-  arena_ref.size          = iarena_size;
-  std::uint32_t block_id  = ibank.blocks.emplace();
-  block&        block_ref = ibank.blocks[block_id];
-  block_ref.offset        = 0;
-  block_ref.arena         = arena_id;
-  block_ref.data          = ihandle;
-  block_ref.size          = iarena_size;
-  if (iempty)
+  auto node    = bank.blocks.index(handle);
+  auto measure = this->statistics::report_deallocate(bank.blocks[node].size);
+  bank.blocks.renew(node);
+  if (cache(node))
+    return;
+  if (!max_deferred)
   {
-    block_ref.is_free = true;
-    arena_ref.free    = iarena_size;
-    ibank.strat.add_free_arena(ibank.blocks, block_id);
-    ibank.free_size += iarena_size;
+    release(node);
+    return;
   }
-  else
+  generation++;
+  deferred.push_back(node);
+  if (deferred.size() >= max_deferred)
+    flush_deferred();
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::deallocate(std::span<ihandle const> handles)
+{
+  std::size_t total = 0;
+  batch_handles.clear();
+  for (auto handle : handles)
   {
-    arena_ref.free = 0;
+    auto node = bank.blocks.index(handle);
+    bank.blocks.renew(node);
+    total += bank.blocks[node].size;
+    batch_handles.push_back(node);
   }
-  arena_ref.block_order.push_back(ibank.blocks, block_id);
-  ibank.arena_order.push_back(ibank.arenas, arena_id);
-  return std::make_pair(arena_id, block_id);
+  auto measure = this->statistics::report_deallocate(total, static_cast<std::uint32_t>(handles.size()));
+  release_sorted(batch_handles);
 }
 
 template <typename traits>
-inline void arena_allocator_impl<traits>::defragment()
+inline void arena_allocator_impl<traits>::release_sorted(std::vector<ihandle>& sorted)
 {
-  manager.begin_defragment(*this);
-  std::uint32_t arena_id = bank.arena_order.first;
-  // refresh all banks
-  bank_data refresh;
+  // joined blocks only pay off where a release searches the free list, buddy and tlsf release one by one
+  if constexpr (!k_strategy_iterates)
+  {
+    for (auto node : sorted)
+      release(node);
+    return;
+  }
 
-  std::vector<std::uint32_t> rebinds;
-  rebinds.reserve(bank.blocks.size());
+  std::sort(sorted.begin(), sorted.end(), [this](ihandle a, ihandle b) {
+    std::uint32_t arena_a = bank.blocks[a].arena, arena_b = bank.blocks[b].arena;
+    return arena_a != arena_b ? arena_a < arena_b : bank.blocks[a].offset < bank.blocks[b].offset;
+  });
 
-  std::vector<memory_move>   moves;
-  decltype(bank.arena_order) deleted_arenas;
-  for (auto arena_it = bank.arena_order.front(); arena_it != k_null_32;)
+  std::size_t runs = 0;
+  for (std::size_t i = 0; i < sorted.size();)
   {
-    auto& arena           = bank.arenas[arena_it];
-    bool  arena_allocated = false;
-
-    for (auto blk_it = arena.block_order.begin(bank.blocks); blk_it; blk_it = arena.block_order.erase(blk_it))
+    auto node = sorted[i++];
+    // allocations next to each other are joined and released as one block
+    while (i < sorted.size() && sorted[i] == bank.blocks.info(node).arena_order.next)
     {
-      auto& blk = *blk_it;
-      if (!blk.is_free)
-      {
-        auto id = refresh.strat.try_allocate(refresh, blk.size);
-        if (!refresh.strat.is_valid(id) && !arena_allocated)
-        {
-          auto p                       = add_arena(refresh, detail::k_null_uh, std::max(arena.size, blk.size), true);
-          refresh.arenas[p.first].data = arena.data;
-          id                           = refresh.strat.try_allocate(refresh, blk.size);
-          arena_allocated              = true;
-        }
-        assert(refresh.strat.is_valid(id));
-
-        auto  new_blk_id = refresh.strat.commit(refresh, blk.size, id);
-        auto& new_blk    = refresh.blocks[new_blk_id];
-        refresh.arenas[new_blk.arena].free -= blk.size;
-        refresh.free_size -= blk.size;
-
-        copy(blk, new_blk);
-        rebinds.emplace_back(new_blk_id);
-        auto blk_adj = blk.adjusted_block();
-        push_memmove(moves,
-                     memory_move(blk_adj.first, new_blk.adjusted_offset(), blk_adj.second, blk.arena, new_blk.arena));
-      }
+      bank.blocks[node].size += bank.blocks[sorted[i]].size;
+      bank.arenas[bank.blocks[node].arena].block_order.erase(bank.blocks, sorted[i++]);
     }
+    sorted[runs++] = node;
+  }
+  sorted.resize(runs);
 
-    if (!arena_allocated)
+  if constexpr (k_strategy_batches)
+  {
+    if (runs > 1)
     {
-      auto to_delete = arena_it;
-      arena_it       = bank.arena_order.unlink(bank.arenas, to_delete);
-      arena.free     = arena.size;
-      deleted_arenas.push_back(bank.arenas, to_delete);
+      release_merged(sorted);
+      return;
     }
-    else
-      arena_it = bank.arena_order.next(bank.arenas, arena_it);
   }
+  for (auto node : sorted)
+    release(node);
+}
 
-  for (auto& m : moves)
-    // follow the copy sequence to ensure there is no overwrite
-    manager.move_memory(bank.arenas[m.arena_src].data, refresh.arenas[m.arena_dst].data, m.from, m.to, m.size);
-
-  for (auto rb : rebinds)
+template <typename traits>
+inline void arena_allocator_impl<traits>::release_merged(std::vector<ihandle>& runs)
+{
+  generation++;
+  // runs that empty their arena are released one by one, so the arena is dropped or retained as usual
+  std::size_t kept = 0;
+  for (std::size_t first = 0; first < runs.size();)
   {
-    auto& dst_blk = refresh.blocks[rb];
-    manager.rebind_alloc(dst_blk.data, alloc_info(refresh.arenas[dst_blk.arena].data, dst_blk.adjusted_offset(), rb));
+    auto      arena_id = bank.blocks[runs[first]].arena;
+    auto      last     = first;
+    size_type size     = 0;
+    for (; last < runs.size() && bank.blocks[runs[last]].arena == arena_id; ++last)
+      size += bank.blocks[runs[last]].size;
+
+    auto& arena = bank.arenas[arena_id];
+    if (arena.free + arena.cached + size == arena.size)
+    {
+      for (; first < last; ++first)
+        release(runs[first]);
+      continue;
+    }
+    arena.free += size;
+    bank.free_size += size;
+    for (; first < last; ++first)
+    {
+      bank.blocks[runs[first]].is_pinned = false;
+      runs[kept++]                       = runs[first];
+    }
   }
+  runs.resize(kept);
 
-  for (auto arena_it = deleted_arenas.begin(bank.arenas); arena_it; arena_it = deleted_arenas.erase(arena_it))
+  // the free neighbours of the runs leave the strategy together, a block between two runs is listed once
+  auto& batch = batch_blocks;
+  batch.clear();
+  for (auto node : runs)
   {
-    auto& arena = *arena_it;
-    manager.remove_arena(arena.data);
-    statistics::report_defrag_arenas_removed();
+    auto const& node_list = bank.arenas[bank.blocks[node].arena].block_order;
+    auto const& links     = bank.blocks.info(node).arena_order;
+    if (node != node_list.front() && bank.blocks[links.prev].is_free && (batch.empty() || batch.back() != links.prev))
+      batch.push_back(links.prev);
+    if (node != node_list.back() && bank.blocks[links.next].is_free)
+      batch.push_back(links.next);
   }
+  bank.strat.erase(bank.blocks, std::span(batch));
 
-  bank = std::move(refresh);
-  manager.end_defragment(*this);
+  // then the runs take them over and the merged blocks come back together
+  batch.clear();
+  for (auto node : runs)
+  {
+    auto& node_list = bank.arenas[bank.blocks[node].arena].block_order;
+    auto  prev      = bank.blocks.info(node).arena_order.prev;
+    if (node != node_list.front() && bank.blocks[prev].is_free)
+    {
+      bank.blocks[prev].size += bank.blocks[node].size;
+      node_list.erase(bank.blocks, node);
+      node = prev;
+    }
+    auto next = bank.blocks.info(node).arena_order.next;
+    if (node != node_list.back() && bank.blocks[next].is_free)
+    {
+      bank.blocks[node].size += bank.blocks[next].size;
+      node_list.erase(bank.blocks, next);
+    }
+    bank.blocks[node].is_free = true;
+    if (batch.empty() || batch.back() != node)
+      batch.push_back(node);
+  }
+  bank.strat.add_free(bank.blocks, std::span(batch));
 }
 
 template <typename traits>
-inline typename arena_allocator_impl<traits>::size_type arena_allocator_impl<traits>::finalize_commit(
-    block& blk, uhandle huser, size_type alignment)
+inline bool arena_allocator_impl<traits>::try_expand(ihandle handle, size_type new_size)
 {
-  blk.data      = huser;
-  blk.alignment = static_cast<std::uint8_t>(CPPALLOC_POPCOUNT(static_cast<std::uint32_t>(alignment)));
-  bank.arenas[blk.arena].free -= blk.size;
-  bank.free_size -= blk.size;
-  return ((blk.offset + alignment) & ~alignment);
+  auto        node  = bank.blocks.index(handle);
+  auto const& blk   = bank.blocks[node];
+  auto        desc  = alloc_desc(new_size, bank.blocks.alignment_mask(node) + 1, bank.blocks.info(node).data);
+  auto        size  = bank.blocks.padding(node) + request_size(desc);
+  if (size <= blk.size)
+    return true;
+  // a buddy block has the size of its level, growing it in place would break it
+  if constexpr (k_strategy_coalesces)
+    return false;
+  else
+  {
+    size_type available = bank.blocks[node].size;
+    auto      it        = bank.blocks.info(node).arena_order.next;
+    while (it != k_null_32 && bank.blocks[it].is_free && available < size)
+    {
+      available += bank.blocks[it].size;
+      it = bank.blocks.info(it).arena_order.next;
+    }
+    if (available < size)
+      return false;
+
+    generation++;
+    auto& arena   = bank.arenas[bank.blocks[node].arena];
+    auto  grown   = size - bank.blocks[node].size;
+    auto  measure = this->statistics::report_allocate(grown, 0);
+    arena.free -= grown;
+    bank.free_size -= grown;
+    while (bank.blocks[node].size < size)
+    {
+      auto next = bank.blocks.info(node).arena_order.next;
+      auto take = std::min(bank.blocks[next].size, size - bank.blocks[node].size);
+      bank.strat.erase(bank.blocks, next);
+      bank.blocks[node].size += take;
+      if (take == bank.blocks[next].size)
+      {
+        arena.block_order.erase(bank.blocks, next);
+        continue;
+      }
+
+      // the rest of the free block goes back
+      auto& rest = bank.blocks[next];
+      rest.offset += take;
+      rest.size -= take;
+      bank.strat.add_free(bank.blocks, next);
+    }
+    return true;
+  }
 }
 
 template <typename traits>
-inline void arena_allocator_impl<traits>::copy(block const& src, block& dst)
+inline void arena_allocator_impl<traits>::shrink(ihandle handle, size_type new_size)
 {
-  dst.data      = src.data;
-  dst.alignment = src.alignment;
+  auto        node  = bank.blocks.index(handle);
+  auto const& blk   = bank.blocks[node];
+  auto        desc  = alloc_desc(new_size, bank.blocks.alignment_mask(node) + 1, bank.blocks.info(node).data);
+  auto        size  = bank.blocks.padding(node) + request_size(desc);
+  // as in try_expand, a buddy block keeps the size of its level
+  if (k_strategy_coalesces || size >= blk.size)
+    return;
+
+  auto arena   = bank.blocks[node].arena;
+  auto offset  = bank.blocks[node].offset + size;
+  auto tail    = bank.blocks[node].size - size;
+  auto id      = bank.blocks.emplace(offset, tail, arena);
+  auto measure = this->statistics::report_deallocate(tail, 0);
+
+  bank.blocks[node].size = size;
+  bank.arenas[arena].block_order.insert_after(bank.blocks, node, id);
+  // the tail is given back like a deallocated block, so it merges with the free space after it
+  release(id);
 }
 
 template <typename traits>
-inline void arena_allocator_impl<traits>::push_memmove(std::vector<memory_move>& dst, memory_move value)
+inline void arena_allocator_impl<traits>::release(ihandle node)
 {
-  if (!value.is_moved())
-    return;
-  auto can_merge = [](memory_move const& m1, memory_move const& m2) -> bool {
+  generation++;
+  auto& blk     = bank.blocks[node];
+  blk.is_pinned = false;
+
+  auto& arena = bank.arenas[blk.arena];
+  bank.free_size += blk.size;
+  arena.free += blk.size;
+
+  if (arena.cached && arena.free + arena.cached == arena.size)
+    flush_cache(blk.arena);
+  if (arena.free == arena.size && !retain_arena(blk.arena) && drop_arena(blk.arena))
+    return;
+
+  merge_free(bank, node);
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::merge_free(bank_data& ibank, std::uint32_t node)
+{
+  // the strategy merges the block with its free space on its own
+  if constexpr (k_strategy_coalesces)
+    ibank.strat.coalesce(ibank, node);
+  else
+  {
+    enum
+    {
+      f_left  = 1 << 0,
+      f_right = 1 << 1,
+    };
+
+    enum merge_type
+    {
+      e_none,
+      e_left,
+      e_right,
+      e_left_and_right
+    };
+
+    auto& blk       = ibank.blocks[node];
+    auto& node_list = ibank.arenas[blk.arena].block_order;
+    auto  size      = blk.size;
+
+    std::uint32_t left = detail::k_null_32, right = detail::k_null_32;
+    std::uint32_t merges = 0;
+
+    auto const& links = ibank.blocks.info(node).arena_order;
+    if (node != node_list.front() && ibank.blocks[links.prev].is_free)
+    {
+      left = links.prev;
+      merges |= f_left;
+    }
+
+    if (node != node_list.back() && ibank.blocks[links.next].is_free)
+    {
+      right = links.next;
+      merges |= f_right;
+    }
+
+    switch (merges)
+    {
+    case merge_type::e_none:
+      ibank.strat.add_free(ibank.blocks, node);
+      blk.is_free = true;
+      break;
+    case merge_type::e_left:
+      ibank.strat.replace(ibank.blocks, left, left, ibank.blocks[left].size + size);
+      node_list.erase(ibank.blocks, node);
+      break;
+    case merge_type::e_right:
+      ibank.strat.replace(ibank.blocks, right, node, ibank.blocks[right].size + size);
+      node_list.erase(ibank.blocks, right);
+      blk.is_free = true;
+      break;
+    case merge_type::e_left_and_right:
+      ibank.strat.erase(ibank.blocks, right);
+      ibank.strat.replace(ibank.blocks, left, left, ibank.blocks[left].size + ibank.blocks[right].size + size);
+      node_list.erase2(ibank.blocks, node);
+    }
+  }
+}
+
+template <typename traits>
+inline bool arena_allocator_impl<traits>::cache(ihandle node)
+{
+  auto& blk   = bank.blocks[node];
+  auto& arena = bank.arenas[blk.arena];
+  // the last block in use of an arena is released, it takes the cached ones along
+  if (blk.size >= cache_heads.size() || cached_blocks == max_cached_blocks ||
+      arena.free + arena.cached + blk.size == arena.size)
+    return false;
+
+  generation++;
+  blk.is_pinned               = false;
+  bank.blocks.info(node).data = cache_heads[blk.size];
+  cache_heads[blk.size]       = node;
+  arena.cached += blk.size;
+  cached_blocks++;
+  return true;
+}
+
+template <typename traits>
+inline std::uint32_t arena_allocator_impl<traits>::take_cached(size_type size, size_type alignment_mask)
+{
+  if (size >= cache_heads.size())
+    return k_null_32;
+
+  // only the last block released with this size is looked at
+  auto node = cache_heads[size];
+  if (node == k_null_32 || (bank.blocks[node].offset & alignment_mask))
+    return k_null_32;
+  cache_heads[size] = bank.blocks.info(node).data;
+  bank.arenas[bank.blocks[node].arena].cached -= size;
+  cached_blocks--;
+  return node;
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::flush_cache()
+{
+  for (auto& head : cache_heads)
+    while (head != k_null_32)
+    {
+      auto node = head;
+      head      = bank.blocks.info(node).data;
+      bank.arenas[bank.blocks[node].arena].cached -= bank.blocks[node].size;
+      cached_blocks--;
+      release(node);
+    }
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::flush_cache(std::uint32_t arena_id)
+{
+  auto& arena = bank.arenas[arena_id];
+  for (auto& head : cache_heads)
+    for (auto* link = &head; *link != k_null_32 && arena.cached;)
+    {
+      auto  node = *link;
+      auto& blk  = bank.blocks[node];
+      if (blk.arena != arena_id)
+      {
+        link = &bank.blocks.info(node).data;
+        continue;
+      }
+
+      *link = bank.blocks.info(node).data;
+      cached_blocks--;
+      arena.cached -= blk.size;
+      arena.free += blk.size;
+      bank.free_size += blk.size;
+      merge_free(bank, node);
+    }
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::flush_deferred()
+{
+  if (deferred.empty())
+    return;
+  release_sorted(deferred);
+  deferred.clear();
+}
+
+template <typename traits>
+inline bool arena_allocator_impl<traits>::flush_held()
+{
+  bool held = cached_blocks || !deferred.empty();
+  flush_deferred();
+  flush_cache();
+  return held;
+}
+
+template <typename traits>
+inline typename arena_allocator_impl<traits>::bank_data const& arena_allocator_impl<traits>::without_held(
+    bank_data& scratch) const
+{
+  if (!cached_blocks && deferred.empty())
+    return bank;
+
+  // a copy with the cached and deferred blocks released, arenas that empty out are kept so plans see them as free
+  scratch           = bank;
+  auto release_copy = [&scratch](std::uint32_t node) {
+    auto  size  = scratch.blocks[node].size;
+    auto& arena = scratch.arenas[scratch.blocks[node].arena];
+    arena.free += size;
+    scratch.free_size += size;
+    merge_free(scratch, node);
+  };
+  for (auto head : cache_heads)
+    for (auto node = head; node != k_null_32; node = bank.blocks.info(node).data)
+    {
+      scratch.arenas[scratch.blocks[node].arena].cached -= scratch.blocks[node].size;
+      release_copy(node);
+    }
+  for (auto node : deferred)
+    release_copy(node);
+  return scratch;
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::validate_integrity()
+{
+  std::uint32_t total_free_nodes = 0;
+  std::uint32_t total_nodes      = 0;
+  for (auto blk_id : bank.blocks)
+  {
+    if (bank.blocks[blk_id].is_free)
+      total_free_nodes++;
+    total_nodes++;
+  }
+  assert(total_nodes == bank.blocks.size());
+
+  if constexpr (!k_strategy_coalesces)
+    assert(total_free_nodes == bank.strat.total_free_nodes(bank.blocks));
+  assert(bank.strat.total_free_size(bank.blocks) == bank.free_size);
+
+  std::uint32_t total_cached = 0;
+  size_type     cached_size  = 0;
+  for (std::size_t size = 0; size < cache_heads.size(); ++size)
+    for (auto node = cache_heads[size]; node != k_null_32; node = bank.blocks.info(node).data, ++total_cached)
+    {
+      assert(!bank.blocks[node].is_free && bank.blocks[node].size == size);
+      cached_size += size;
+    }
+  assert(total_cached == cached_blocks);
+  for (auto arena_it = bank.arena_order.begin(bank.arenas), arena_end_it = bank.arena_order.end(bank.arenas);
+       arena_it != arena_end_it; ++arena_it)
+    cached_size -= arena_it->cached;
+  assert(cached_size == 0);
+  assert(deferred.empty() || deferred.size() < max_deferred);
+  for (auto node : deferred)
+    assert(!bank.blocks[node].is_free);
+
+  for (auto arena_it = bank.arena_order.begin(bank.arenas), arena_end_it = bank.arena_order.end(bank.arenas);
+       arena_it != arena_end_it; ++arena_it)
+  {
+    auto&     arena           = *arena_it;
+    bool      arena_allocated = false;
+    size_type expected_offset = 0;
+
+    for (auto blk_it = arena.block_order.begin(bank.blocks), blk_end_it = arena.block_order.end(bank.blocks);
+         blk_it != blk_end_it; ++blk_it)
+    {
+      auto& blk = *blk_it;
+      // a strategy that keeps its free space lists only the blocks in use, in no order
+      if constexpr (!k_strategy_coalesces)
+        assert(blk.offset == expected_offset);
+      expected_offset += blk.size;
+      total_nodes--;
+    }
+  }
+  // every block in the bank but the sentinel belongs to an arena
+  assert(total_nodes == 1);
+
+  bank.strat.validate_integrity(bank.blocks);
+}
+
+template <typename traits>
+inline std::pair<ihandle, ihandle> arena_allocator_impl<traits>::add_arena(uhandle ihandle, size_type iarena_size,
+                                                                           bool empty)
+{
+  this->statistics::report_new_arena();
+  auto ret                    = add_arena(bank, ihandle, iarena_size, empty);
+  bank.arenas[ret.first].data = manager.add_arena(ret.first, iarena_size);
+  return ret;
+}
+
+template <typename traits>
+inline std::pair<ihandle, ihandle> arena_allocator_impl<traits>::add_arena(bank_data& ibank, uhandle ihandle,
+                                                                           size_type iarena_size, bool iempty)
+{
+
+  std::uint32_t arena_id  = ibank.arenas.emplace();
+  auto&         arena_ref = ibank.arenas[arena_id];
+  arena_ref.size          = iarena_size;
+  arena_ref.free          = iempty ? iarena_size : 0;
+  if (iempty)
+    ibank.free_size += iarena_size;
+
+  std::uint32_t block_id = k_null_32;
+  if constexpr (k_strategy_coalesces)
+  {
+    // the strategy keeps the free space, only the allocation of a dedicated arena gets a block
+    ibank.strat.add_arena(ibank, arena_id, iempty);
+    if (!iempty)
+    {
+      block_id = ibank.blocks.emplace(0, iarena_size, arena_id, ihandle);
+      arena_ref.block_order.push_back(ibank.blocks, block_id);
+    }
+  }
+  else
+  {
+    block_id = ibank.blocks.emplace(0, iarena_size, arena_id, ihandle, iempty);
+    if (iempty)
+      ibank.strat.add_free_arena(ibank.blocks, block_id);
+    arena_ref.block_order.push_back(ibank.blocks, block_id);
+  }
+  ibank.arena_order.push_back(ibank.arenas, arena_id);
+  return std::make_pair(arena_id, block_id);
+}
+
+template <typename traits>
+inline bool arena_allocator_impl<traits>::retain_arena(std::uint32_t arena_id)
+{
+  if (max_retained == 0 || bank.arenas[arena_id].size > growth.cap())
+    return false;
+
+  // entries of arenas that were filled again since they were kept
+  std::erase_if(retained_arenas, [&](auto const& r) {
+    return r.first == arena_id || bank.arenas[r.first].free != bank.arenas[r.first].size;
+  });
+  if (retained_arenas.size() == max_retained)
+    expire_arena();
+  retained_arenas.emplace_back(arena_id, allocations);
+  statistics::report_arena_retained();
+  return true;
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::expire_arena()
+{
+  auto arena_id = retained_arenas.front().first;
+  retained_arenas.erase(retained_arenas.begin());
+  auto const& arena = bank.arenas[arena_id];
+  if (arena.free == arena.size && drop_arena(arena_id))
+    statistics::report_arena_expired();
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::expire_arenas()
+{
+  while (!retained_arenas.empty())
+  {
+    auto const& r     = retained_arenas.front();
+    auto const& arena = bank.arenas[r.first];
+    if (arena.free == arena.size && allocations - r.second <= retain_allocations)
+      break;
+    expire_arena();
+  }
+}
+
+template <typename traits>
+inline bool arena_allocator_impl<traits>::drop_arena(std::uint32_t arena_id)
+{
+  auto& arena = bank.arenas[arena_id];
+  if (!manager.drop_arena(arena.data))
+    return false;
+  if (arena.size <= growth.cap())
+    growth.shrink();
+
+  if constexpr (k_strategy_coalesces)
+    bank.strat.erase_arena(arena_id);
+  else
+  {
+    auto& node_list = arena.block_order;
+    for (auto it = node_list.front(); it != k_null_32; it = node_list.next(bank.blocks, it))
+      if (bank.blocks[it].is_free)
+        bank.strat.erase(bank.blocks, it);
+  }
+
+  if (defrag_cursor == arena_id)
+    defrag_cursor = bank.arena_order.next(bank.arenas, arena_id);
+  bank.free_size -= arena.size;
+  arena.size = 0;
+  arena.block_order.clear(bank.blocks);
+  bank.arena_order.erase(bank.arenas, arena_id);
+  return true;
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::defragment()
+{
+  flush_held();
+  apply_plan(defrag_occupancy < 1.0f ? plan_evacuation(defrag_occupancy) : plan_defragment());
+}
+
+template <typename traits>
+inline typename arena_allocator_impl<traits>::defrag_plan arena_allocator_impl<traits>::plan_defragment() const
+{
+  if constexpr (k_strategy_coalesces)
+  {
+    // buddy blocks are not packed inside their arena, the sparsest arenas whose blocks fit in the free space of the
+    // others are emptied instead
+    bank_data        scratch;
+    bank_data const& src    = without_held(scratch);
+    auto             sparse = by_occupancy(src);
+    size_type        used   = 0;
+    size_type        room   = src.free_size;
+    std::size_t      count  = 0;
+    for (; count < sparse.size(); ++count)
+    {
+      auto& arena = src.arenas[sparse[count]];
+      used += arena.size - arena.free;
+      room -= arena.free;
+      if (used > room)
+        break;
+    }
+    sparse.resize(count);
+    return plan_evacuation(src, sparse);
+  }
+  else
+    return plan_compaction();
+}
+
+template <typename traits>
+inline typename arena_allocator_impl<traits>::defrag_plan arena_allocator_impl<traits>::plan_compaction() const
+{
+  defrag_plan      plan;
+  bank_data        scratch;
+  bank_data const& src = without_held(scratch);
+  // refresh all banks
+  bank_data& refresh = plan.bank;
+  plan.generation    = generation;
+  plan.rebinds.reserve(src.blocks.size());
+  // every block is rebound to a block of the rebuilt bank, the handles of the current one must not match them
+  refresh.blocks.supersede(src.blocks);
+
+  for (auto arena_it = src.arena_order.front(); arena_it != k_null_32;
+       arena_it      = src.arena_order.next(src.arenas, arena_it))
+  {
+    auto& arena = src.arenas[arena_it];
+
+    // the blocks that do not fit in the arenas already rebuilt are packed at the front of a reserved copy of their
+    // arena, that front never passes their current place so no block lands over data that is yet to be moved
+    std::uint32_t new_arena = k_null_32;
+    size_type     front     = 0;
+
+    for (auto blk_it = arena.block_order.front(); blk_it != k_null_32;
+         blk_it      = arena.block_order.next(src.blocks, blk_it))
+    {
+      auto& blk = src.blocks[blk_it];
+      if (blk.is_free)
+        continue;
+
+      if (!blk.is_pinned)
+      {
+        // as in a best fit, a free block larger than what is left behind the front is not taken
+        auto mask = src.blocks.alignment_mask(blk_it);
+        auto id   = find_aligned(refresh, src.blocks.adjusted_size(blk_it), mask);
+        if (refresh.strat.is_valid(id) &&
+            (new_arena == k_null_32 || refresh.blocks[refresh.strat.node(id)].size < arena.size - front))
+        {
+          // padding stays in the block as in the blocks packed at the front, so a plan of the result moves nothing
+          auto  new_blk_id = commit_aligned(refresh, src.blocks.adjusted_size(blk_it), mask, id, true);
+          auto& new_blk    = refresh.blocks[new_blk_id];
+          refresh.arenas[new_blk.arena].free -= new_blk.size;
+          refresh.free_size -= new_blk.size;
+          plan_move(plan, src, blk_it, new_blk_id);
+          continue;
+        }
+      }
+
+      if (new_arena == k_null_32)
+      {
+        new_arena     = refresh.arenas.emplace();
+        auto reserved = refresh.blocks.emplace(size_type(0), arena.size, new_arena);
+        auto& new_ref = refresh.arenas[new_arena];
+        new_ref.size  = arena.size;
+        new_ref.data  = arena.data;
+        new_ref.free  = 0;
+        new_ref.block_order.push_back(refresh.blocks, reserved);
+        refresh.arena_order.push_back(refresh.arenas, new_arena);
+      }
+
+      // pinned blocks keep their place, the others start at the front with the padding their alignment needs
+      auto offset = blk.is_pinned ? blk.offset : front;
+      auto size   = src.blocks.size_at(blk_it, offset);
+      release_range(refresh, new_arena, front, offset);
+      plan_move(plan, src, blk_it, carve(refresh, new_arena, offset, size));
+      front = offset + size;
+    }
+
+    if (new_arena == k_null_32)
+    {
+      plan.deleted_arenas.push_back(arena_it);
+      plan.arenas_freed++;
+      plan.bytes_reclaimed += arena.size;
+    }
+    else
+      release_range(refresh, new_arena, front, arena.size);
+  }
+
+  plan.move_merges += group_moves(plan.moves);
+  plan.fragmentation = fragmentation(refresh);
+  return plan;
+}
+
+template <typename traits>
+inline typename arena_allocator_impl<traits>::defrag_plan arena_allocator_impl<traits>::plan_evacuation(
+    float max_occupancy) const
+{
+  bank_data        scratch;
+  bank_data const& src    = without_held(scratch);
+  auto             sparse = by_occupancy(src);
+  std::erase_if(sparse, [&src, max_occupancy](std::uint32_t arena_id) {
+    auto& arena = src.arenas[arena_id];
+    return !(static_cast<float>(arena.size - arena.free) / static_cast<float>(arena.size) < max_occupancy);
+  });
+  return plan_evacuation(src, sparse);
+}
+
+template <typename traits>
+inline std::vector<std::uint32_t> arena_allocator_impl<traits>::by_occupancy(bank_data const& src) const
+{
+  auto occupancy = [&src](std::uint32_t arena_id) {
+    auto& arena = src.arenas[arena_id];
+    return static_cast<float>(arena.size - arena.free) / static_cast<float>(arena.size);
+  };
+
+  std::vector<std::uint32_t> arenas;
+  for (auto arena_it = src.arena_order.front(); arena_it != k_null_32;
+       arena_it      = src.arena_order.next(src.arenas, arena_it))
+  {
+    if (next_pinned(src.arenas[arena_it].block_order.front()) == k_null_32)
+      arenas.push_back(arena_it);
+  }
+  std::stable_sort(arenas.begin(), arenas.end(), [&occupancy](std::uint32_t a, std::uint32_t b) {
+    return occupancy(a) < occupancy(b);
+  });
+  return arenas;
+}
+
+template <typename traits>
+inline typename arena_allocator_impl<traits>::defrag_plan arena_allocator_impl<traits>::plan_evacuation(
+    bank_data const& src, std::vector<std::uint32_t> const& sparse) const
+{
+  defrag_plan plan;
+  bank_data&  refresh = plan.bank;
+
+  auto for_each_free = [&](std::uint32_t arena_id, auto&& fn) {
+    auto& arena = refresh.arenas[arena_id];
+    for (auto blk_it = arena.block_order.front(); blk_it != k_null_32;
+         blk_it      = arena.block_order.next(refresh.blocks, blk_it))
+      if (refresh.blocks[blk_it].is_free)
+        fn(blk_it);
+  };
+
+  // sparsest first, evacuation stops at the first arena whose blocks do not all fit as denser arenas will not fit
+  // either. If some of its blocks were committed already, the arenas before it are planned again on a fresh copy,
+  // which is cheaper than keeping a copy of the plan per arena.
+  std::size_t evacuated = 0;
+  for (std::size_t limit = sparse.size();; limit = evacuated)
+  {
+    plan = defrag_plan();
+    // work on a copy, block and arena ids stay the same
+    refresh         = src;
+    plan.generation = generation;
+
+    // nothing may be placed in an arena that is being emptied
+    for (auto arena_id : sparse)
+    {
+      if constexpr (k_strategy_coalesces)
+        refresh.strat.exclude_arena(arena_id, true);
+      else
+        for_each_free(arena_id, [&](std::uint32_t blk) {
+          refresh.strat.erase(refresh.blocks, blk);
+        });
+    }
+
+    bool partial = false;
+    for (evacuated = 0; evacuated < limit; ++evacuated)
+    {
+      auto  arena_id = sparse[evacuated];
+      auto& arena    = src.arenas[arena_id];
+      // most arenas that cannot fit are caught before any of their blocks is committed
+      if (arena.size - arena.free > refresh.free_size)
+        break;
+
+      bool        placed    = true;
+      std::size_t committed = 0;
+      for (auto blk_it = arena.block_order.front(); blk_it != k_null_32;
+           blk_it      = arena.block_order.next(src.blocks, blk_it))
+      {
+        auto& blk = src.blocks[blk_it];
+        if (blk.is_free)
+          continue;
+        auto mask = src.blocks.alignment_mask(blk_it);
+        auto id   = find_aligned(refresh, src.blocks.adjusted_size(blk_it), mask);
+        if (!refresh.strat.is_valid(id))
+        {
+          partial = committed > 0;
+          placed  = false;
+          break;
+        }
+
+        auto  new_blk_id = commit_aligned(refresh, src.blocks.adjusted_size(blk_it), mask, id, true);
+        auto& new_blk    = refresh.blocks[new_blk_id];
+        refresh.arenas[new_blk.arena].free -= new_blk.size;
+        refresh.free_size -= new_blk.size;
+        plan_move(plan, src, blk_it, new_blk_id);
+        committed++;
+      }
+      if (!placed)
+        break;
+
+      auto& dead = refresh.arenas[arena_id];
+      if constexpr (k_strategy_coalesces)
+        refresh.strat.erase_arena(arena_id);
+      refresh.free_size -= dead.free;
+      dead.block_order.clear(refresh.blocks);
+      refresh.arena_order.erase(refresh.arenas, arena_id);
+      plan.deleted_arenas.push_back(arena_id);
+      plan.arenas_freed++;
+      plan.bytes_reclaimed += arena.size;
+    }
+
+    if (!partial)
+      break;
+  }
+
+  for (; evacuated < sparse.size(); ++evacuated)
+  {
+    if constexpr (k_strategy_coalesces)
+      refresh.strat.exclude_arena(sparse[evacuated], false);
+    else
+      for_each_free(sparse[evacuated], [&](std::uint32_t blk) {
+        refresh.strat.add_free(refresh.blocks, blk);
+      });
+  }
+
+  plan.move_merges += group_moves(plan.moves);
+  plan.fragmentation = fragmentation(refresh);
+  return plan;
+}
+
+template <typename traits>
+inline bool arena_allocator_impl<traits>::apply_plan(defrag_plan&& plan)
+{
+  if (plan.generation != generation)
+    return false;
+
+  manager.begin_defragment(*this);
+  dispatch(plan.moves, plan.rebinds);
+
+  for (auto arena_id : plan.deleted_arenas)
+  {
+    manager.remove_arena(bank.arenas[arena_id].data);
+    statistics::report_defrag_arenas_removed(bank.arenas[arena_id].size);
+  }
+  if (plan.move_merges)
+    statistics::report_defrag_mem_move_merge(plan.move_merges);
+  if (plan.blocks_moved)
+    statistics::report_defrag_block_moved(plan.bytes_to_move, plan.blocks_moved);
+
+  // a rebuilt bank numbers its arenas anew, retained entries follow their user arena or go with it
+  auto& refresh = plan.bank;
+  for (auto& r : retained_arenas)
+  {
+    auto data = bank.arenas[r.first].data;
+    r.first   = k_null_32;
+    for (auto it = refresh.arena_order.front(); it != k_null_32 && r.first == k_null_32;
+         it      = refresh.arena_order.next(refresh.arenas, it))
+      if (refresh.arenas[it].data == data)
+        r.first = it;
+  }
+  std::erase_if(retained_arenas, [](auto const& r) {
+    return r.first == k_null_32;
+  });
+
+  bank          = std::move(plan.bank);
+  defrag_cursor = k_null_32;
+  generation++;
+  // the plan was made with the cached and deferred blocks released
+  std::fill(cache_heads.begin(), cache_heads.end(), k_null_32);
+  cached_blocks = 0;
+  deferred.clear();
+  manager.end_defragment(*this);
+  return true;
+}
+
+template <typename traits>
+inline bool arena_allocator_impl<traits>::defragment_step(defrag_budget const& budget)
+{
+  // buddy arenas have no holes to slide blocks over
+  if constexpr (k_strategy_coalesces)
+    return true;
+  else
+    return compact_step(budget);
+}
+
+template <typename traits>
+inline bool arena_allocator_impl<traits>::compact_step(defrag_budget const& budget)
+{
+  flush_held();
+  if (defrag_cursor == k_null_32)
+    defrag_cursor = bank.arena_order.front();
+
+  auto          start        = std::chrono::steady_clock::now();
+  size_type     bytes_moved  = 0;
+  std::uint32_t blocks_moved = 0;
+  bool          started      = false;
+
+  auto spend = [&](size_type size) -> bool {
+    bytes_moved += size;
+    blocks_moved++;
+    return bytes_moved >= budget.bytes || blocks_moved >= budget.blocks ||
+           (budget.time != std::chrono::microseconds::max() &&
+            std::chrono::steady_clock::now() - start >= budget.time);
+  };
+
+  // only the first block of a step may go over the byte budget, so every step makes progress
+  auto affordable = [&](size_type size) -> bool {
+    return blocks_moved == 0 || size <= budget.bytes - bytes_moved;
+  };
+
+  auto begin = [&]() {
+    if (!started)
+      manager.begin_defragment(*this);
+    started = true;
+  };
+
+  bool exhausted = budget.bytes == 0 || budget.blocks == 0 || budget.time.count() == 0;
+  while (defrag_cursor != k_null_32 && !exhausted)
+  {
+    auto& arena = bank.arenas[defrag_cursor];
+
+    // slide live blocks left, the hole keeps its id and travels to the end of the arena
+    std::uint32_t hole = k_null_32;
+    for (std::uint32_t it = arena.block_order.front(); it != k_null_32 && !exhausted;)
+    {
+      auto& blk  = bank.blocks[it];
+      auto  next = bank.blocks.info(it).arena_order.next;
+      if (!blk.is_free || next == k_null_32 || bank.blocks[next].is_pinned)
+      {
+        hole = blk.is_free ? it : k_null_32;
+        it   = next;
+        continue;
+      }
+
+      if (bank.blocks[next].is_free)
+      {
+        // free neighbours are left apart by strategies that only merge buddies
+        bank.strat.erase(bank.blocks, it);
+        bank.strat.erase(bank.blocks, next);
+        blk.size += bank.blocks[next].size;
+        arena.block_order.erase(bank.blocks, next);
+        bank.strat.add_free(bank.blocks, it);
+        continue;
+      }
+
+      // a hole narrower than the padding the block would need leaves it where it is
+      if (bank.blocks.size_at(next, blk.offset) >= blk.size + bank.blocks[next].size)
+      {
+        it = next;
+        continue;
+      }
+
+      auto size = bank.blocks[next].size;
+      if (!affordable(size))
+      {
+        exhausted = true;
+        break;
+      }
+      begin();
+      slide_block(it, next);
+      exhausted = spend(size);
+    }
+
+    if (exhausted)
+      break;
+
+    // fill the tail hole with blocks from the last arenas
+    for (std::uint32_t src = bank.arena_order.back(); hole != k_null_32 && src != defrag_cursor && !exhausted;)
+    {
+      auto          prev = bank.arenas[src].order.prev;
+      std::uint32_t it   = bank.arenas[src].block_order.front();
+      while (it != k_null_32 && hole != k_null_32 && !exhausted)
+      {
+        auto next = bank.blocks.info(it).arena_order.next;
+        while (next != k_null_32 && bank.blocks[next].is_free)
+          next = bank.blocks.info(next).arena_order.next;
+
+        if (!bank.blocks[it].is_free && !bank.blocks[it].is_pinned &&
+            bank.blocks.size_at(it, bank.blocks[hole].offset) <= bank.blocks[hole].size)
+        {
+          auto size = bank.blocks[it].size;
+          if (!affordable(size))
+          {
+            exhausted = true;
+            break;
+          }
+          begin();
+          pull_block(hole, it);
+          exhausted = spend(size);
+        }
+        it = next;
+      }
+      src = prev;
+    }
+
+    flush_moves();
+    if (!exhausted)
+      defrag_cursor = bank.arena_order.next(bank.arenas, defrag_cursor);
+  }
+
+  flush_moves();
+  if (started)
+    manager.end_defragment(*this);
+  return defrag_cursor == k_null_32;
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::slide_block(std::uint32_t hole, std::uint32_t node)
+{
+  generation++;
+  auto& hole_blk = bank.blocks[hole];
+  auto& blk      = bank.blocks[node];
+  auto& arena    = bank.arenas[blk.arena];
+  auto& list     = arena.block_order;
+  auto  src      = bank.blocks.adjusted_block(node);
+  auto  end      = blk.offset + blk.size;
+  auto  size     = bank.blocks.size_at(node, hole_blk.offset);
+
+  // the block keeps the padding it needs at its new place, the hole gets the rest
+  bank.strat.erase(bank.blocks, hole);
+  arena.free      = arena.free + blk.size - size;
+  bank.free_size  = bank.free_size + blk.size - size;
+  blk.offset      = hole_blk.offset;
+  blk.size        = size;
+  hole_blk.offset = blk.offset + size;
+  hole_blk.size   = end - hole_blk.offset;
+  list.unlink(bank.blocks, hole);
+  list.insert_after(bank.blocks, node, hole);
+
+  auto right = bank.blocks.info(hole).arena_order.next;
+  if (right != k_null_32 && bank.blocks[right].is_free)
+  {
+    bank.strat.erase(bank.blocks, right);
+    hole_blk.size += bank.blocks[right].size;
+    list.erase(bank.blocks, right);
+  }
+  bank.strat.add_free(bank.blocks, hole);
+  notify_move(node, blk.arena, src);
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::pull_block(std::uint32_t& hole, std::uint32_t node)
+{
+  bank.strat.erase(bank.blocks, hole);
+  auto size     = bank.blocks.size_at(node, bank.blocks[hole].offset);
+  auto arena_id = bank.blocks[hole].arena;
+  auto offset   = bank.blocks[hole].offset;
+  auto new_node = bank.blocks.emplace(offset, size, arena_id);
+
+  auto& hole_blk = bank.blocks[hole];
+  auto& arena    = bank.arenas[arena_id];
+  arena.block_order.insert(bank.blocks, hole, new_node);
+  hole_blk.offset += size;
+  hole_blk.size -= size;
+  if (hole_blk.size == 0)
+  {
+    arena.block_order.erase(bank.blocks, hole);
+    hole = k_null_32;
+  }
+  else
+    bank.strat.add_free(bank.blocks, hole);
+
+  arena.free -= size;
+  bank.free_size -= size;
+
+  copy(bank.blocks, node, bank.blocks, new_node);
+  notify_move(new_node, bank.blocks[node].arena, bank.blocks.adjusted_block(node));
+  // the memory is still to be read
+  pending_releases.push_back(node);
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::notify_move(std::uint32_t node, std::uint32_t src_arena,
+                                                       std::pair<size_type, size_type> src)
+{
+  auto& blk    = bank.blocks[node];
+  auto  offset = bank.blocks.adjusted_offset(node);
+  pending_moves.emplace_back(src.first, offset, src.second, bank.arenas[src_arena].data, bank.arenas[blk.arena].data);
+  pending_rebinds.emplace_back(bank.blocks.info(node).data,
+                               alloc_info(bank.arenas[blk.arena].data, offset, bank.blocks.handle(node)));
+  statistics::report_defrag_block_moved(src.second);
+}
+
+template <typename traits>
+inline typename arena_allocator_impl<traits>::size_type arena_allocator_impl<traits>::finalize_commit(
+    std::uint32_t node, alloc_desc const& desc)
+{
+  auto& blk = bank.blocks[node];
+  bank.arenas[blk.arena].free -= blk.size;
+  bank.free_size -= blk.size;
+  return assign(node, desc);
+}
+
+template <typename traits>
+inline typename arena_allocator_impl<traits>::size_type arena_allocator_impl<traits>::assign(std::uint32_t     node,
+                                                                                             alloc_desc const& desc)
+{
+  auto& blk       = bank.blocks[node];
+  auto& info      = bank.blocks.info(node);
+  auto  alignment = desc.alignment_mask();
+  info.data       = desc.huser();
+  info.alignment  = static_cast<std::uint8_t>(CPPALLOC_POPCOUNT(static_cast<std::uint32_t>(alignment)));
+  blk.is_pinned   = (desc.flags() & f_pinned) != 0;
+  return ((blk.offset + alignment) & ~alignment);
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::copy(block_bank const& src, std::uint32_t src_node, block_bank& dst,
+                                               std::uint32_t dst_node)
+{
+  dst.info(dst_node).data      = src.info(src_node).data;
+  dst.info(dst_node).alignment = src.info(src_node).alignment;
+  dst[dst_node].is_pinned      = src[src_node].is_pinned;
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::plan_move(defrag_plan& plan, bank_data const& src, std::uint32_t blk_id,
+                                                    std::uint32_t new_blk_id)
+{
+  auto& blk     = src.blocks[blk_id];
+  auto& refresh = plan.bank;
+  auto& new_blk = refresh.blocks[new_blk_id];
+
+  copy(src.blocks, blk_id, refresh.blocks, new_blk_id);
+  auto offset = refresh.blocks.adjusted_offset(new_blk_id);
+  plan.rebinds.emplace_back(src.blocks.info(blk_id).data, alloc_info(refresh.arenas[new_blk.arena].data, offset,
+                                                                     refresh.blocks.handle(new_blk_id)));
+  auto        blk_adj = src.blocks.adjusted_block(blk_id);
+  memory_move move(blk_adj.first, offset, blk_adj.second, src.arenas[blk.arena].data,
+                   refresh.arenas[new_blk.arena].data);
+  if (!move.is_moved())
+    return;
+
+  plan.bytes_to_move += move.size;
+  plan.blocks_moved++;
+  if (push_memmove(plan.moves, move))
+    plan.move_merges++;
+}
+
+template <typename traits>
+inline std::uint32_t arena_allocator_impl<traits>::carve(bank_data& ibank, std::uint32_t arena_id, size_type offset,
+                                                         size_type size)
+{
+  auto& arena = ibank.arenas[arena_id];
+  auto& list  = arena.block_order;
+  auto  it    = list.front();
+  while (ibank.blocks[it].offset + ibank.blocks[it].size <= offset)
+    it = ibank.blocks.info(it).arena_order.next;
+
+  // either a free block or a reserved one that is not yet handed out
+  bool      is_free = ibank.blocks[it].is_free;
+  size_type start   = ibank.blocks[it].offset;
+  size_type end     = start + ibank.blocks[it].size;
+  assert(!ibank.blocks[it].is_pinned && ibank.blocks.info(it).data == detail::k_null_sz<uhandle>);
+  assert(start <= offset && offset + size <= end);
+
+  if (is_free)
+  {
+    ibank.strat.erase(ibank.blocks, it);
+    arena.free -= size;
+    ibank.free_size -= size;
+  }
+
+  if (start < offset)
+  {
+    auto left = ibank.blocks.emplace(start, offset - start, arena_id, detail::k_null_sz<uhandle>, is_free);
+    list.insert(ibank.blocks, it, left);
+    if (is_free)
+      ibank.strat.add_free(ibank.blocks, left);
+  }
+  if (offset + size < end)
+  {
+    auto right =
+        ibank.blocks.emplace(offset + size, end - offset - size, arena_id, detail::k_null_sz<uhandle>, is_free);
+    list.insert_after(ibank.blocks, it, right);
+    if (is_free)
+      ibank.strat.add_free(ibank.blocks, right);
+  }
+
+  auto& carved   = ibank.blocks[it];
+  carved.offset  = offset;
+  carved.size    = size;
+  carved.is_free = false;
+  return it;
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::release_range(bank_data& ibank, std::uint32_t arena_id, size_type offset,
+                                                        size_type end)
+{
+  if (offset >= end)
+    return;
+  auto  id    = carve(ibank, arena_id, offset, end - offset);
+  auto& blk   = ibank.blocks[id];
+  blk.is_free = true;
+  ibank.arenas[arena_id].free += blk.size;
+  ibank.free_size += blk.size;
+  ibank.strat.add_free(ibank.blocks, id);
+}
+
+template <typename traits>
+inline std::uint32_t arena_allocator_impl<traits>::next_pinned(std::uint32_t blk_id) const
+{
+  while (blk_id != k_null_32 && (bank.blocks[blk_id].is_free || !bank.blocks[blk_id].is_pinned))
+    blk_id = bank.blocks.info(blk_id).arena_order.next;
+  return blk_id;
+}
+
+template <typename traits>
+inline bool arena_allocator_impl<traits>::push_memmove(std::vector<memory_move>& dst, memory_move value)
+{
+  auto can_merge = [](memory_move const& m1, memory_move const& m2) -> bool {
     return ((m1.arena_dst == m2.arena_dst && m1.arena_src == m2.arena_src) &&
             (m1.from + m1.size == m2.from && m1.to + m1.size == m2.to));
   };
   if (dst.empty() || !can_merge(dst.back(), value))
+  {
     dst.emplace_back(value);
+    return false;
+  }
+  dst.back().size += value.size;
+  return true;
+}
+
+template <typename traits>
+inline std::uint32_t arena_allocator_impl<traits>::group_moves(std::vector<memory_move>& moves)
+{
+  // moves out of an arena into others only read it and can go first, grouped by destination, the ones inside the
+  // arena keep their order
+  for (auto it = moves.begin(); it != moves.end();)
+  {
+    auto run = std::find_if(it, moves.end(), [src = it->arena_src](memory_move const& m) {
+      return m.arena_src != src;
+    });
+    auto inner = std::stable_partition(it, run, [](memory_move const& m) {
+      return m.arena_src != m.arena_dst;
+    });
+    std::stable_sort(it, inner, [](memory_move const& a, memory_move const& b) {
+      return a.arena_dst < b.arena_dst;
+    });
+    it = run;
+  }
+
+  std::vector<memory_move> merged;
+  std::uint32_t            merges = 0;
+  merged.reserve(moves.size());
+  for (auto const& m : moves)
+    if (push_memmove(merged, m))
+      merges++;
+  moves = std::move(merged);
+  return merges;
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::dispatch(std::span<memory_move const> moves,
+                                                    std::span<rebind_info const> rebinds)
+{
+  if constexpr (k_batch_moves)
+  {
+    // one batch so the manager can copy between different arenas concurrently, the moves stay grouped by pair
+    if (!moves.empty())
+      manager.move_memory(moves);
+  }
   else
   {
-    dst.back().size += value.size;
-    statistics::report_defrag_mem_move_merge();
+    // follow the copy sequence to ensure there is no overwrite
+    for (auto const& m : moves)
+      manager.move_memory(m.arena_src, m.arena_dst, m.from, m.to, m.size);
   }
+
+  if constexpr (k_batch_rebinds)
+  {
+    if (!rebinds.empty())
+      manager.rebind_allocs(rebinds);
+  }
+  else
+  {
+    for (auto const& r : rebinds)
+      manager.rebind_alloc(r.huser, r.info);
+  }
+}
+
+template <typename traits>
+inline void arena_allocator_impl<traits>::flush_moves()
+{
+  dispatch(pending_moves, pending_rebinds);
+  pending_moves.clear();
+  pending_rebinds.clear();
+  // the moved blocks were rebound, their old handles are stale
+  for (auto node : pending_releases)
+  {
+    bank.blocks.renew(node);
+    release(node);
+  }
+  pending_releases.clear();
+}
+
+template <typename traits>
+inline float arena_allocator_impl<traits>::fragmentation(bank_data const& ibank)
+{
+  if (ibank.free_size == 0)
+    return 0.0f;
+
+  size_type largest = 0;
+  if constexpr (k_strategy_coalesces)
+    largest = ibank.strat.largest_free();
+  else
+    for (auto blk_id : ibank.blocks)
+    {
+      auto& blk = ibank.blocks[blk_id];
+      if (blk.is_free)
+        largest = std::max(largest, blk.size);
+    }
+  return 1.0f - static_cast<float>(largest) / static_cast<float>(ibank.free_size);
 }
 } // namespace cppalloc::detail
@@ -1,5 +1,5 @@
 ﻿#pragma once
-#include <detail/memory_move.hpp>
+#include <alloc_desc.hpp>
 
 namespace cppalloc::detail
 {
@@ -11,54 +11,179 @@ namespace cppalloc::detail
 //  ██████╔╝███████╗╚██████╔╝╚██████╗██║--██╗
 //  ╚═════╝-╚══════╝-╚═════╝--╚═════╝╚═╝--╚═╝
 //  -----------------------------------------
+//! Fields of a block read while searching for free space: the size, position, the strategy links and the flags
+//! packed next to the arena number. Everything else is kept apart in block_info.
 template <typename traits>
 struct block
 {
   using size_type = typename traits::size_type;
   using extension = typename traits::extension;
 
-  size_type         offset      = detail::k_null_sz<size_type>;
-  size_type         size        = 0;
-  uhandle           data        = detail::k_null_sz<uhandle>;
-  std::uint32_t     arena       = detail::k_null_32;
+  //! Arenas a block can refer to, the bits above the arena number hold the flags
+  static constexpr std::uint32_t k_arena_bits = 29;
+
+  size_type                       offset     = detail::k_null_sz<size_type>;
+  size_type                       size       = 0;
+  std::uint32_t                   arena      : k_arena_bits;
+  std::uint32_t                   is_free    : 1;
+  std::uint32_t                   is_flagged : 1;
+  std::uint32_t                   is_pinned  : 1;
+  [[no_unique_address]] extension ext;
+
+  block() : block(detail::k_null_sz<size_type>, 0, 0) {}
+  block(size_type ioffset, size_type isize, std::uint32_t iarena, bool ifree = false)
+      : offset(ioffset), size(isize), arena(iarena), is_free(ifree), is_flagged(0), is_pinned(0)
+  {
+    assert(iarena < (1u << k_arena_bits));
+  }
+};
+
+//! Fields of a block that are not needed to find free space, the alignment is only read once a block is chosen
+struct block_info
+{
   detail::list_node arena_order = detail::list_node();
-  bool              is_free     = false;
+  uhandle           data        = detail::k_null_sz<uhandle>;
+  //! log2 of the alignment of the allocation
   std::uint8_t      alignment   = 0;
-  bool              is_flagged  = false;
-  extension         ext;
+};
+
+//! Blocks stored as two parallel arrays indexed by the same id, the strategies walk the compact `block` array while
+//! the arena order and user handles live in the `block_info` array
+template <typename traits>
+class block_bank
+{
+public:
+  using size_type = typename traits::size_type;
 
-  block() {}
-  block(size_type ioffset, size_type isize, std::uint32_t iarena) : offset(ioffset), size(isize), arena(iarena) {}
-  block(size_type ioffset, size_type isize, std::uint32_t iarena, uhandle idata)
-      : offset(ioffset), size(isize), arena(iarena), data(idata)
+  inline std::uint32_t emplace(size_type offset, size_type size, std::uint32_t arena,
+                               uhandle data = detail::k_null_sz<uhandle>, bool is_free = false)
   {
+    auto id = blocks.emplace(offset, size, arena, is_free);
+    infos.reserve(id + 1);
+    infos[id] = block_info{detail::list_node(), data};
+    return id;
   }
-  block(size_type ioffset, size_type isize, std::uint32_t iarena, uhandle idata, bool ifree)
-      : offset(ioffset), size(isize), arena(iarena), data(idata), is_free(ifree)
+
+  inline void erase(std::uint32_t id)
   {
+    blocks.erase(id);
   }
 
-  inline std::pair<size_type, size_type> adjusted_block() const
+  inline block<traits>& operator[](std::uint32_t id)
   {
-    size_type alignment_mask = (1u << alignment) - 1u;
-    return std::make_pair<size_type>((offset + alignment_mask) & ~alignment_mask, size - alignment_mask);
+    return blocks[id];
   }
 
-  inline size_type adjusted_size() const
+  inline block<traits> const& operator[](std::uint32_t id) const
   {
-    size_type alignment_mask = (1u << alignment) - 1u;
-    return size - alignment_mask;
+    return blocks[id];
   }
 
-  inline size_type adjusted_offset() const
+  //! Aligned offset and size of the allocation inside a block
+  inline std::pair<size_type, size_type> adjusted_block(std::uint32_t id) const
   {
-    size_type alignment_mask = (1u << alignment) - 1u;
-    return (offset + alignment_mask) & ~alignment_mask;
+    return std::make_pair(adjusted_offset(id), adjusted_size(id));
   }
-};
 
-template <typename traits>
-using block_bank = detail::table<block<traits>>;
+  inline size_type adjusted_size(std::uint32_t id) const
+  {
+    return blocks[id].size - padding(id);
+  }
+
+  inline size_type adjusted_offset(std::uint32_t id) const
+  {
+    return align(blocks[id].offset, alignment_mask(id));
+  }
+
+  //! Bytes in front of the aligned offset, single allocations start aligned while blocks of a batch or moved by a
+  //! defragmentation may keep a few
+  inline size_type padding(std::uint32_t id) const
+  {
+    return adjusted_offset(id) - blocks[id].offset;
+  }
+
+  //! Size a block needs when it is moved to `at`
+  inline size_type size_at(std::uint32_t id, size_type at) const
+  {
+    return align(at, alignment_mask(id)) - at + adjusted_size(id);
+  }
+
+  inline size_type alignment_mask(std::uint32_t id) const
+  {
+    return (size_type(1) << infos[id].alignment) - 1u;
+  }
+
+  //! Handle given out for a block, see table::handle
+  inline std::uint32_t handle(std::uint32_t id) const
+  {
+    return blocks.handle(id);
+  }
+
+  inline std::uint32_t index(std::uint32_t handle) const
+  {
+    return blocks.index(handle);
+  }
+
+  inline void renew(std::uint32_t id)
+  {
+    blocks.renew(id);
+  }
+
+  //! See table::supersede
+  inline void supersede(block_bank const& previous)
+  {
+    blocks.supersede(previous.blocks);
+  }
+
+  inline block_info& info(std::uint32_t id)
+  {
+    return infos[id];
+  }
+
+  inline block_info const& info(std::uint32_t id) const
+  {
+    return infos[id];
+  }
+
+  inline std::uint32_t size() const
+  {
+    return blocks.size();
+  }
+
+  //! Ids of the blocks in use in increasing order, a linear scan of the bank that starts with the sentinel block 0
+  inline auto begin() const
+  {
+    return blocks.begin();
+  }
+
+  inline auto end() const
+  {
+    return blocks.end();
+  }
+
+  inline void reserve(std::uint32_t count)
+  {
+    blocks.reserve(count);
+    infos.reserve(count);
+  }
+
+  inline void shrink_to_fit()
+  {
+    blocks.shrink_to_fit();
+    infos.shrink(blocks.end_index());
+  }
+
+private:
+  using block_table = detail::table<block<traits>>;
+
+  static inline size_type align(size_type offset, size_type mask)
+  {
+    return (offset + mask) & ~mask;
+  }
+
+  block_table                                               blocks;
+  detail::paged_array<block_info, block_table::k_page_bits> infos;
+};
 
 template <typename traits>
 struct block_accessor
@@ -70,12 +195,12 @@ struct block_accessor
 
   inline static detail::list_node& node(bank_type& bank, std::uint32_t node)
   {
-    return bank[node].arena_order;
+    return bank.info(node).arena_order;
   }
 
   inline static detail::list_node const& node(bank_type const& bank, std::uint32_t node)
   {
-    return bank[node].arena_order;
+    return bank.info(node).arena_order;
   }
 
   inline static value_type const& get(bank_type const& bank, std::uint32_t node)
@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include <detail/arena.hpp>
+#include <detail/simd_search.hpp>
 
 namespace cppalloc::detail
 {
@@ -11,6 +12,10 @@ namespace cppalloc::detail
 //  ██████╔╝███████╗███████║---██║███████╗██║-----██║---██║---
 //  ╚═════╝-╚══════╝╚══════╝---╚═╝╚══════╝╚═╝-----╚═╝---╚═╝---
 //  ----------------------------------------------------------
+//! Free blocks are kept in a vector sorted by size. Their sizes are mirrored as 32 bit keys in a parallel array, so a
+//! search reads contiguous keys instead of going through the block bank: it bisects down to a short run and counts
+//! the run with vector compares (see count_less). Keys are kept narrow as every insert shifts them along with the
+//! block ids; sizes past the key range share the largest key and are told apart through the block bank.
 template <typename traits>
 class alloc_strategy_impl<alloc_strategy::best_fit, traits>
 {
@@ -26,7 +31,7 @@ public:
   inline free_list::iterator try_allocate(bank_data& bank, size_type size, free_list::iterator from);
   inline std::uint32_t       commit(bank_data& bank, size_type size, free_list::iterator);
 
-  inline void add_free_arena([[maybe_unused]] block_bank& blocks, std::uint32_t block);
+  inline void add_free_arena(block_bank& blocks, std::uint32_t block);
   inline void add_free(block_bank& blocks, std::uint32_t block);
   inline void replace(block_bank& blocks, std::uint32_t block, std::uint32_t new_block, size_type new_size);
 
@@ -35,6 +40,11 @@ public:
 
   inline void erase(block_bank& blocks, std::uint32_t node);
 
+  //! Batches of erase and add_free, the free blocks are shifted once for the whole batch. `nodes` of add_free are
+  //! sorted by size in place.
+  inline void erase(block_bank& blocks, std::span<std::uint32_t> nodes);
+  inline void add_free(block_bank& blocks, std::span<std::uint32_t> nodes);
+
   inline std::uint32_t total_free_nodes(block_bank& blocks) const;
   inline size_type     total_free_size(block_bank& blocks) const;
 
@@ -48,12 +58,28 @@ private:
   inline free_list::iterator reinsert_left(block_bank& blocks, free_list::iterator of, std::uint32_t node);
   inline free_list::iterator reinsert_right(block_bank& blocks, free_list::iterator of, std::uint32_t node);
 
+  inline free_list::iterator insert_at(free_list::iterator it, std::uint32_t block, size_type size);
+  inline free_list::iterator erase_at(free_list::iterator it);
+
   inline static constexpr std::uint32_t null()
   {
     return detail::k_null_32;
   }
 
-  free_list free_ordering;
+  inline static constexpr std::uint32_t key(size_type size)
+  {
+    if constexpr (sizeof(size_type) > sizeof(std::uint32_t))
+      return size < k_max_key ? static_cast<std::uint32_t>(size) : k_max_key;
+    else
+      return static_cast<std::uint32_t>(size);
+  }
+
+  //! Runs this short are searched linearly
+  static constexpr std::uint32_t k_linear_search = 16;
+  static constexpr std::uint32_t k_max_key       = std::numeric_limits<std::uint32_t>::max();
+
+  free_list                  free_ordering;
+  std::vector<std::uint32_t> keys;
 };
 
 /// alloc_strategy::best_fit Impl
@@ -62,7 +88,7 @@ template <typename traits>
 inline free_list::iterator alloc_strategy_impl<alloc_strategy::best_fit, traits>::try_allocate(bank_data& bank,
                                                                                                size_type  size)
 {
-  if (free_ordering.size() == 0 || bank.blocks[free_ordering.back()].size < size)
+  if (free_ordering.empty() || bank.blocks[free_ordering.back()].size < size)
     return free_ordering.end();
   return find_free(bank.blocks, free_ordering.begin(), free_ordering.end(), size);
 }
@@ -105,17 +131,18 @@ inline std::uint32_t alloc_strategy_impl<alloc_strategy::best_fit, traits>::comm
   else
   {
     // delete the existing found index from free list
-    free_ordering.erase(found);
+    erase_at(found);
   }
 
   return free_node;
 }
 
 template <typename traits>
-inline void alloc_strategy_impl<alloc_strategy::best_fit, traits>::add_free_arena([[maybe_unused]] block_bank& blocks,
-                                                                                  std::uint32_t                block)
+inline void alloc_strategy_impl<alloc_strategy::best_fit, traits>::add_free_arena(block_bank&   blocks,
+                                                                                  std::uint32_t block)
 {
-  free_ordering.push_back(block);
+  insert_at(find_free(blocks, free_ordering.begin(), free_ordering.end(), blocks[block].size), block,
+            blocks[block].size);
 }
 
 template <typename traits>
@@ -153,7 +180,7 @@ inline void alloc_strategy_impl<alloc_strategy::best_fit, traits>::add_free_afte
 {
   blocks[block].is_free = true;
   auto it               = find_free(blocks, loc, free_ordering.end(), blocks[block].size);
-  free_ordering.emplace(it, block);
+  insert_at(it, block, blocks[block].size);
 }
 
 template <typename traits>
@@ -175,7 +202,63 @@ inline void alloc_strategy_impl<alloc_strategy::best_fit, traits>::erase(block_b
   while (it != free_ordering.end() && *it != node)
     it++;
   assert(it != free_ordering.end());
-  free_ordering.erase(it);
+  erase_at(it);
+}
+
+template <typename traits>
+inline void alloc_strategy_impl<alloc_strategy::best_fit, traits>::erase(block_bank&              blocks,
+                                                                         std::span<std::uint32_t> nodes)
+{
+  // flagged blocks are dropped in one pass, flags are not used otherwise by this strategy
+  for (auto node : nodes)
+    blocks[node].is_flagged = true;
+
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < free_ordering.size(); ++i)
+  {
+    auto& blk = blocks[free_ordering[i]];
+    if (blk.is_flagged)
+    {
+      blk.is_flagged = false;
+      continue;
+    }
+    free_ordering[kept] = free_ordering[i];
+    keys[kept++]        = keys[i];
+  }
+  free_ordering.resize(kept);
+  keys.resize(kept);
+}
+
+template <typename traits>
+inline void alloc_strategy_impl<alloc_strategy::best_fit, traits>::add_free(block_bank&              blocks,
+                                                                            std::span<std::uint32_t> nodes)
+{
+  std::sort(nodes.begin(), nodes.end(),
+            [&blocks](std::uint32_t a, std::uint32_t b) { return blocks[a].size < blocks[b].size; });
+
+  // merged in from the back, the larger of the two next blocks goes last
+  auto i = free_ordering.size();
+  auto j = nodes.size();
+  free_ordering.resize(i + j);
+  keys.resize(i + j);
+  for (auto k = i + j; j > 0;)
+  {
+    auto      block = nodes[j - 1];
+    size_type size  = blocks[block].size;
+    if (i > 0 && (keys[i - 1] > key(size) || (keys[i - 1] == k_max_key && blocks[free_ordering[i - 1]].size > size)))
+    {
+      --i;
+      free_ordering[--k] = free_ordering[i];
+      keys[k]            = keys[i];
+    }
+    else
+    {
+      --j;
+      blocks[block].is_free = true;
+      free_ordering[--k]    = block;
+      keys[k]               = key(size);
+    }
+  }
 }
 
 template <typename traits>
@@ -201,11 +284,13 @@ inline typename alloc_strategy_impl<alloc_strategy::best_fit, traits>::size_type
 template <typename traits>
 inline void alloc_strategy_impl<alloc_strategy::best_fit, traits>::validate_integrity(block_bank& blocks)
 {
+  assert(keys.size() == free_ordering.size());
   size_type sz = 0;
-  for (auto fn : free_ordering)
+  for (std::size_t i = 0; i < free_ordering.size(); ++i)
   {
-    assert(sz <= blocks[fn].size);
-    sz = blocks[fn].size;
+    assert(sz <= blocks[free_ordering[i]].size);
+    assert(keys[i] == key(blocks[free_ordering[i]].size));
+    sz = blocks[free_ordering[i]].size;
   }
 }
 
@@ -215,9 +300,39 @@ inline free_list::iterator alloc_strategy_impl<alloc_strategy::best_fit, traits>
                                                                                             free_list::iterator e,
                                                                                             size_type           i_size)
 {
-  return std::lower_bound(b, e, i_size, [&blocks](std::uint32_t block, size_type i_size) -> bool {
-    return blocks[block].size < i_size;
-  });
+  auto i_key = key(i_size);
+  auto first = static_cast<std::uint32_t>(std::distance(free_ordering.begin(), b));
+  auto last  = static_cast<std::uint32_t>(std::distance(free_ordering.begin(), e));
+  while (last - first > k_linear_search)
+  {
+    auto mid = first + ((last - first) >> 1);
+    if (keys[mid] < i_key)
+      first = mid + 1;
+    else
+      last = mid;
+  }
+  auto it = free_ordering.begin() + first + count_less(keys.data() + first, last - first, i_key);
+  if (i_key == k_max_key)
+    it = std::lower_bound(it, e, i_size, [&blocks](std::uint32_t block, size_type i_size) -> bool {
+      return blocks[block].size < i_size;
+    });
+  return it;
+}
+
+template <typename traits>
+inline free_list::iterator alloc_strategy_impl<alloc_strategy::best_fit, traits>::insert_at(free_list::iterator it,
+                                                                                            std::uint32_t       block,
+                                                                                            size_type           size)
+{
+  keys.insert(keys.begin() + std::distance(free_ordering.begin(), it), key(size));
+  return free_ordering.insert(it, block);
+}
+
+template <typename traits>
+inline free_list::iterator alloc_strategy_impl<alloc_strategy::best_fit, traits>::erase_at(free_list::iterator it)
+{
+  keys.erase(keys.begin() + std::distance(free_ordering.begin(), it));
+  return free_ordering.erase(it);
 }
 
 template <typename traits>
@@ -226,24 +341,30 @@ inline free_list::iterator alloc_strategy_impl<alloc_strategy::best_fit, traits>
                                                                                                 std::uint32_t node)
 {
   auto begin_it = free_ordering.begin();
+  auto size     = blocks[node].size;
   if (begin_it == of)
   {
-    *of = node;
+    *of     = node;
+    keys[0] = key(size);
     return of;
   }
-  auto it = find_free(blocks, begin_it, of, blocks[node].size);
+  auto it = find_free(blocks, begin_it, of, size);
+  auto at = std::distance(begin_it, it);
   if (it != of)
   {
     std::uint32_t* src   = &*it;
     std::uint32_t* dest  = src + 1;
     size_t         count = std::distance(it, of);
     std::memmove(dest, src, count * sizeof(std::uint32_t));
-    *it = node;
+    std::memmove(keys.data() + at + 1, keys.data() + at, count * sizeof(std::uint32_t));
+    *it      = node;
+    keys[at] = key(size);
     return it;
   }
   else
   {
-    *of = node;
+    *of      = node;
+    keys[at] = key(size);
     return it;
   }
 }
@@ -256,25 +377,31 @@ inline free_list::iterator alloc_strategy_impl<alloc_strategy::best_fit, traits>
 
   auto end_it = free_ordering.end();
   auto next   = std::next(of);
+  auto size   = blocks[node].size;
+  auto at     = std::distance(free_ordering.begin(), of);
   if (next == end_it)
   {
-    *of = node;
+    *of      = node;
+    keys[at] = key(size);
     return of;
   }
-  auto it = find_free(blocks, next, end_it, blocks[node].size);
+  auto it = find_free(blocks, next, end_it, size);
   if (it != next)
   {
     std::uint32_t* dest  = &(*of);
     std::uint32_t* src   = dest + 1;
     size_t         count = std::distance(next, it);
     std::memmove(dest, src, count * sizeof(std::uint32_t));
-    auto ptr = (dest + count);
-    *ptr     = node;
+    std::memmove(keys.data() + at, keys.data() + at + 1, count * sizeof(std::uint32_t));
+    auto ptr         = (dest + count);
+    *ptr             = node;
+    keys[at + count] = key(size);
     return free_ordering.begin() + std::distance(free_ordering.data(), ptr);
   }
   else
   {
-    *of = node;
+    *of      = node;
+    keys[at] = key(size);
     return it;
   }
 }
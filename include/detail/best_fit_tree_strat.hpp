@@ -28,9 +28,20 @@ public:
   using alloc_desc = cppalloc::alloc_desc<size_type>;
   using bank_data  = detail::bank_data<traits>;
 
+  //! Free blocks are ordered by size, then by arena and offset, so of the blocks that fit best the lowest addressed
+  //! one is taken
+  struct free_key
+  {
+    size_type     size   = 0;
+    std::uint32_t arena  = 0;
+    size_type     offset = 0;
+
+    auto operator<=>(free_key const&) const = default;
+  };
+
   struct blk_tree_node_accessor
   {
-    using value_type = size_type;
+    using value_type = free_key;
     using node_type  = block;
     using container  = block_bank;
 
@@ -50,9 +61,9 @@ public:
     {
       return inode.ext;
     }
-    static inline size_type const& value(node_type const& inode)
+    static inline free_key value(node_type const& inode)
     {
-      return inode.size;
+      return free_key{inode.size, inode.arena, inode.offset};
     }
     static inline bool is_set(node_type const& inode)
     {
@@ -76,13 +87,14 @@ public:
 
   inline std::uint32_t try_allocate(bank_data& bank, size_type size)
   {
-    auto blk = tree.lower_bound(bank.blocks, size);
+    auto blk = tree.lower_bound(bank.blocks, free_key{size});
     return ((blk == 0) || (bank.blocks[blk].size < size)) ? k_null_32 : blk;
   }
 
+  //! Next block that fits after `from`, in tree order
   inline std::uint32_t try_allocate(bank_data& bank, size_type size, std::uint32_t from)
   {
-    auto blk = tree.lower_bound(bank.blocks, tree.next_more(bank.blocks, from), size);
+    auto blk = tree.successor(bank.blocks, from);
     return blk == 0 || bank.blocks[blk].size < size ? k_null_32 : blk;
   }
 
@@ -125,9 +137,19 @@ public:
   }
   inline void replace(block_bank& blocks, std::uint32_t block, std::uint32_t new_block, size_type new_size)
   {
-    blocks[new_block].size = new_size;
-    tree.insert_hint(blocks, block, new_block);
-    tree.erase(blocks, block);
+    if (block == new_block)
+    {
+      // the node must leave the tree before its key changes
+      tree.erase(blocks, block);
+      blocks[block].size = new_size;
+      tree.insert(blocks, block);
+    }
+    else
+    {
+      blocks[new_block].size = new_size;
+      tree.insert_hint(blocks, block, new_block);
+      tree.erase(blocks, block);
+    }
   }
   inline std::uint32_t node(std::uint32_t it)
   {
@@ -0,0 +1,526 @@
+#pragma once
+#include <detail/arena.hpp>
+#include <detail/simd_search.hpp>
+
+namespace cppalloc::detail
+{
+
+//  ██████╗-████████╗██████╗-███████╗███████╗
+//  ██╔══██╗╚══██╔══╝██╔══██╗██╔════╝██╔════╝
+//  ██████╔╝---██║---██████╔╝█████╗--█████╗--
+//  ██╔══██╗---██║---██╔══██╗██╔══╝--██╔══╝--
+//  ██████╔╝---██║---██║--██║███████╗███████╗
+//  ╚═════╝----╚═╝---╚═╝--╚═╝╚══════╝╚══════╝
+//  -----------------------------------------
+//! Best fit over a B+tree of the free blocks.
+//!
+//! Free blocks are ordered by size, then by block id. A node keeps the sizes of its keys in one contiguous array
+//! followed by their block ids, so it is searched with a few vector compares (see count_less) and a lookup reads one
+//! node per level, where the red-black tree reads one block per level. Leaves are chained in key order to list the
+//! next fitting blocks.
+template <typename traits>
+class alloc_strategy_impl<alloc_strategy::btree, traits>
+{
+public:
+  using size_type  = typename traits::size_type;
+  using arena_bank = detail::arena_bank<traits>;
+  using block_bank = detail::block_bank<traits>;
+  using block      = detail::block<traits>;
+  using alloc_desc = cppalloc::alloc_desc<size_type>;
+  using bank_data  = detail::bank_data<traits>;
+
+  //! Keys per node, their sizes take two cache lines with 64 bit sizes
+  static constexpr std::uint32_t k_width = 16;
+  //! Fewest keys of a leaf other than the root, inner nodes keep one less
+  static constexpr std::uint32_t k_min = k_width / 2;
+  //! Levels of inner nodes, enough for any number of blocks
+  static constexpr std::uint32_t k_max_height = 32;
+
+  //! A free block: the leaf that holds it and its slot
+  struct iterator
+  {
+    std::uint32_t leaf = k_null_32;
+    std::uint32_t slot = 0;
+  };
+
+  alloc_strategy_impl()
+  {
+    root  = leaves.emplace();
+    first = root;
+  }
+
+  inline iterator try_allocate([[maybe_unused]] bank_data& bank, size_type size)
+  {
+    auto n = root;
+    for (std::uint32_t h = 0; h < height; ++h)
+    {
+      auto const& inner = inners[n];
+      n                 = inner.children[count_less(inner.sizes.data(), k_width, size)];
+    }
+    auto const& leaf = leaves[n];
+    auto        slot = count_less(leaf.sizes.data(), k_width, size);
+    return slot < leaf.count ? iterator{n, slot} : iterator{leaf.next, 0};
+  }
+
+  //! Next block after `from` in key order, it is at least as large
+  inline iterator try_allocate([[maybe_unused]] bank_data& bank, [[maybe_unused]] size_type size, iterator from)
+  {
+    if (from.slot + 1 < leaves[from.leaf].count)
+      return iterator{from.leaf, from.slot + 1};
+    return iterator{leaves[from.leaf].next, 0};
+  }
+
+  inline std::uint32_t commit(bank_data& bank, size_type size, iterator found)
+  {
+    if (!is_valid(found))
+      return k_null_32;
+
+    auto  id  = node(found);
+    auto& blk = bank.blocks[id];
+    blk.is_free    = false;
+    auto remaining = blk.size - size;
+    if (remaining > 0)
+    {
+      auto& list   = bank.arenas[blk.arena].block_order;
+      auto  arena  = blk.arena;
+      auto  newblk = bank.blocks.emplace(blk.offset + size, remaining, arena, detail::k_null_sz<uhandle>, true);
+      // the rest takes the key of the block, in place when the order allows
+      replace_at(bank.blocks, found, newblk, remaining);
+      bank.blocks[id].size = size;
+      list.insert_after(bank.blocks, id, newblk);
+    }
+    else
+      erase_key(blk.size, id);
+    return id;
+  }
+
+  inline void add_free_arena(block_bank& blocks, std::uint32_t block)
+  {
+    insert_key(blocks[block].size, block);
+  }
+  inline void add_free(block_bank& blocks, std::uint32_t block)
+  {
+    insert_key(blocks[block].size, block);
+  }
+  inline void replace(block_bank& blocks, std::uint32_t block, std::uint32_t new_block, size_type new_size)
+  {
+    path p;
+    auto leaf = descend(blocks[block].size, block, p);
+    auto slot = lower_slot(leaves[leaf], blocks[block].size, block);
+    assert(slot < leaves[leaf].count && leaves[leaf].ids[slot] == block);
+    replace_at(blocks, iterator{leaf, slot}, new_block, new_size, &p);
+  }
+  inline std::uint32_t node(iterator it)
+  {
+    return leaves[it.leaf].ids[it.slot];
+  }
+  inline bool is_valid(iterator it)
+  {
+    return it.leaf != k_null_32;
+  }
+  inline void erase(block_bank& blocks, std::uint32_t node)
+  {
+    erase_key(blocks[node].size, node);
+  }
+
+  inline std::uint32_t total_free_nodes([[maybe_unused]] block_bank const& blocks) const
+  {
+    return free_count;
+  }
+
+  inline size_type total_free_size(block_bank const& blocks) const
+  {
+    size_type sz = 0;
+    for (auto l = first; l != k_null_32; l = leaves[l].next)
+      for (std::uint32_t i = 0; i < leaves[l].count; ++i)
+        sz += blocks[leaves[l].ids[i]].size;
+    return sz;
+  }
+
+  void validate_integrity(block_bank const& blocks)
+  {
+    std::uint32_t count = 0;
+    iterator      prev;
+    for (auto l = first; l != k_null_32; l = leaves[l].next)
+    {
+      auto const& leaf = leaves[l];
+      assert(l == root || leaf.count >= k_min);
+      for (std::uint32_t i = 0; i < k_width; ++i)
+      {
+        if (i >= leaf.count)
+        {
+          assert(leaf.sizes[i] == k_null_sz<size_type>);
+          continue;
+        }
+        assert(blocks[leaf.ids[i]].size == leaf.sizes[i]);
+        assert(!is_valid(prev) || less(leaves[prev.leaf].sizes[prev.slot], leaves[prev.leaf].ids[prev.slot],
+                                       leaf.sizes[i], leaf.ids[i]));
+        prev = iterator{l, i};
+        count++;
+      }
+    }
+    assert(count == free_count);
+    validate_node(root, 0, nullptr, nullptr);
+  }
+
+private:
+  struct leaf_node
+  {
+    //! Unused slots hold k_null_sz so they never compare less
+    alignas(64) std::array<size_type, k_width> sizes;
+    std::array<std::uint32_t, k_width>          ids;
+    std::uint32_t                               count = 0;
+    std::uint32_t                               next  = k_null_32;
+
+    leaf_node()
+    {
+      sizes.fill(k_null_sz<size_type>);
+    }
+  };
+
+  //! children[i] holds the keys below separator i, children[i + 1] the keys from it on
+  struct inner_node
+  {
+    alignas(64) std::array<size_type, k_width> sizes;
+    std::array<std::uint32_t, k_width>          ids;
+    std::array<std::uint32_t, k_width + 1>      children;
+    std::uint32_t                               count = 0;
+
+    inner_node()
+    {
+      sizes.fill(k_null_sz<size_type>);
+    }
+  };
+
+  using path = std::array<std::pair<std::uint32_t, std::uint32_t>, k_max_height>;
+
+  static inline bool less(size_type size_a, std::uint32_t id_a, size_type size_b, std::uint32_t id_b)
+  {
+    return size_a < size_b || (size_a == size_b && id_a < id_b);
+  }
+
+  // first slot whose key is not below (size, id)
+  template <typename node_type>
+  static inline std::uint32_t lower_slot(node_type const& n, size_type size, std::uint32_t id)
+  {
+    auto slot = count_less(n.sizes.data(), k_width, size);
+    while (slot < n.count && n.sizes[slot] == size && n.ids[slot] < id)
+      slot++;
+    return slot;
+  }
+
+  // child of an inner node that holds (size, id)
+  static inline std::uint32_t child_slot(inner_node const& n, size_type size, std::uint32_t id)
+  {
+    auto slot = count_less(n.sizes.data(), k_width, size);
+    while (slot < n.count && n.sizes[slot] == size && n.ids[slot] <= id)
+      slot++;
+    return slot;
+  }
+
+  template <typename node_type>
+  static inline void insert_slot(node_type& n, std::uint32_t at, size_type size, std::uint32_t id)
+  {
+    std::copy_backward(n.sizes.begin() + at, n.sizes.begin() + n.count, n.sizes.begin() + n.count + 1);
+    std::copy_backward(n.ids.begin() + at, n.ids.begin() + n.count, n.ids.begin() + n.count + 1);
+    n.sizes[at] = size;
+    n.ids[at]   = id;
+    n.count++;
+  }
+
+  template <typename node_type>
+  static inline void erase_slot(node_type& n, std::uint32_t at)
+  {
+    std::copy(n.sizes.begin() + at + 1, n.sizes.begin() + n.count, n.sizes.begin() + at);
+    std::copy(n.ids.begin() + at + 1, n.ids.begin() + n.count, n.ids.begin() + at);
+    n.count--;
+    n.sizes[n.count] = k_null_sz<size_type>;
+  }
+
+  // removes separator `at` and the child right of it
+  static inline void erase_separator(inner_node& n, std::uint32_t at)
+  {
+    std::copy(n.children.begin() + at + 2, n.children.begin() + n.count + 1, n.children.begin() + at + 1);
+    erase_slot(n, at);
+  }
+
+  inline std::uint32_t descend(size_type size, std::uint32_t id, path& p) const
+  {
+    auto n = root;
+    for (std::uint32_t h = 0; h < height; ++h)
+    {
+      auto c = child_slot(inners[n], size, id);
+      p[h]   = std::make_pair(n, c);
+      n      = inners[n].children[c];
+    }
+    return n;
+  }
+
+  // the key at `it` becomes (new_size, new_block), without moving it when it stays between its neighbours. `p` is
+  // the path to the leaf when known.
+  inline void replace_at(block_bank& blocks, iterator it, std::uint32_t new_block, size_type new_size,
+                         path* p = nullptr)
+  {
+    auto& leaf     = leaves[it.leaf];
+    auto  slot     = it.slot;
+    auto  old_size = leaf.sizes[slot];
+    auto  old_id   = leaf.ids[slot];
+    bool  left_ok  = slot > 0 ? less(leaf.sizes[slot - 1], leaf.ids[slot - 1], new_size, new_block)
+                              : !less(new_size, new_block, old_size, old_id);
+    bool  right_ok = slot + 1 < leaf.count ? less(new_size, new_block, leaf.sizes[slot + 1], leaf.ids[slot + 1])
+                                           : !less(old_size, old_id, new_size, new_block);
+    blocks[new_block].size = new_size;
+    if (left_ok && right_ok)
+    {
+      leaf.sizes[slot] = new_size;
+      leaf.ids[slot]   = new_block;
+      return;
+    }
+    if (p)
+      erase_at(*p, it.leaf, slot);
+    else
+      erase_key(old_size, old_id);
+    insert_key(new_size, new_block);
+  }
+
+  inline void insert_key(size_type size, std::uint32_t id)
+  {
+    path p;
+    auto n    = descend(size, id, p);
+    auto slot = lower_slot(leaves[n], size, id);
+    free_count++;
+    if (leaves[n].count < k_width)
+    {
+      insert_slot(leaves[n], slot, size, id);
+      return;
+    }
+
+    // the upper half of a full leaf moves to a new one
+    auto  r     = leaves.emplace();
+    auto& left  = leaves[n];
+    auto& right = leaves[r];
+    std::copy(left.sizes.begin() + k_min, left.sizes.end(), right.sizes.begin());
+    std::copy(left.ids.begin() + k_min, left.ids.end(), right.ids.begin());
+    std::fill(left.sizes.begin() + k_min, left.sizes.end(), k_null_sz<size_type>);
+    left.count  = k_min;
+    right.count = k_width - k_min;
+    right.next  = left.next;
+    left.next   = r;
+    if (slot <= k_min)
+      insert_slot(left, slot, size, id);
+    else
+      insert_slot(right, slot - k_min, size, id);
+
+    size_type     sep_size = right.sizes[0];
+    std::uint32_t sep_id   = right.ids[0];
+    std::uint32_t child    = r;
+    for (std::uint32_t h = height; h-- > 0;)
+    {
+      auto [pn, c] = p[h];
+      if (inners[pn].count < k_width)
+      {
+        auto& parent = inners[pn];
+        std::copy_backward(parent.children.begin() + c + 1, parent.children.begin() + parent.count + 1,
+                           parent.children.begin() + parent.count + 2);
+        parent.children[c + 1] = child;
+        insert_slot(parent, c, sep_size, sep_id);
+        return;
+      }
+
+      // a full inner node splits around its middle separator, which moves up
+      std::array<size_type, k_width + 1>         sizes;
+      std::array<std::uint32_t, k_width + 1>     ids;
+      std::array<std::uint32_t, k_width + 2>     children;
+      auto                                       q   = inners.emplace();
+      auto&                                      in  = inners[pn];
+      auto&                                      out = inners[q];
+      constexpr std::uint32_t                    mid = k_width / 2;
+      std::copy(in.sizes.begin(), in.sizes.begin() + c, sizes.begin());
+      std::copy(in.ids.begin(), in.ids.begin() + c, ids.begin());
+      sizes[c] = sep_size;
+      ids[c]   = sep_id;
+      std::copy(in.sizes.begin() + c, in.sizes.end(), sizes.begin() + c + 1);
+      std::copy(in.ids.begin() + c, in.ids.end(), ids.begin() + c + 1);
+      std::copy(in.children.begin(), in.children.begin() + c + 1, children.begin());
+      children[c + 1] = child;
+      std::copy(in.children.begin() + c + 1, in.children.end(), children.begin() + c + 2);
+
+      std::fill(in.sizes.begin(), in.sizes.end(), k_null_sz<size_type>);
+      std::copy(sizes.begin(), sizes.begin() + mid, in.sizes.begin());
+      std::copy(ids.begin(), ids.begin() + mid, in.ids.begin());
+      std::copy(children.begin(), children.begin() + mid + 1, in.children.begin());
+      in.count = mid;
+      std::copy(sizes.begin() + mid + 1, sizes.end(), out.sizes.begin());
+      std::copy(ids.begin() + mid + 1, ids.end(), out.ids.begin());
+      std::copy(children.begin() + mid + 1, children.end(), out.children.begin());
+      out.count = k_width - mid;
+
+      sep_size = sizes[mid];
+      sep_id   = ids[mid];
+      child    = q;
+    }
+
+    // the root split, the tree grows a level
+    auto  top         = inners.emplace();
+    auto& new_root    = inners[top];
+    new_root.sizes[0] = sep_size;
+    new_root.ids[0]   = sep_id;
+    new_root.children[0] = root;
+    new_root.children[1] = child;
+    new_root.count       = 1;
+    root                 = top;
+    height++;
+    assert(height < k_max_height);
+  }
+
+  inline void erase_key(size_type size, std::uint32_t id)
+  {
+    path p;
+    auto n    = descend(size, id, p);
+    auto slot = lower_slot(leaves[n], size, id);
+    assert(slot < leaves[n].count && leaves[n].ids[slot] == id);
+    erase_at(p, n, slot);
+  }
+
+  inline void erase_at(path const& p, std::uint32_t n, std::uint32_t slot)
+  {
+    erase_slot(leaves[n], slot);
+    free_count--;
+    if (height == 0 || leaves[n].count >= k_min)
+      return;
+
+    auto [pn, c] = p[height - 1];
+    auto& parent = inners[pn];
+    auto& leaf   = leaves[n];
+    if (c > 0 && leaves[parent.children[c - 1]].count > k_min)
+    {
+      auto& left = leaves[parent.children[c - 1]];
+      insert_slot(leaf, 0, left.sizes[left.count - 1], left.ids[left.count - 1]);
+      erase_slot(left, left.count - 1);
+      parent.sizes[c - 1] = leaf.sizes[0];
+      parent.ids[c - 1]   = leaf.ids[0];
+      return;
+    }
+    if (c < parent.count && leaves[parent.children[c + 1]].count > k_min)
+    {
+      auto& right = leaves[parent.children[c + 1]];
+      insert_slot(leaf, leaf.count, right.sizes[0], right.ids[0]);
+      erase_slot(right, 0);
+      parent.sizes[c] = right.sizes[0];
+      parent.ids[c]   = right.ids[0];
+      return;
+    }
+
+    // merge with a sibling, the right one of the two goes away
+    auto  sep   = c > 0 ? c - 1 : c;
+    auto  ri    = parent.children[sep + 1];
+    auto& left  = leaves[parent.children[sep]];
+    auto& right = leaves[ri];
+    std::copy(right.sizes.begin(), right.sizes.begin() + right.count, left.sizes.begin() + left.count);
+    std::copy(right.ids.begin(), right.ids.begin() + right.count, left.ids.begin() + left.count);
+    left.count += right.count;
+    left.next = right.next;
+    leaves.erase(ri);
+    erase_separator(parent, sep);
+
+    for (std::uint32_t h = height - 1;; --h)
+    {
+      auto in = p[h].first;
+      if (h == 0)
+      {
+        if (inners[in].count == 0)
+        {
+          root = inners[in].children[0];
+          inners.erase(in);
+          height--;
+        }
+        return;
+      }
+      if (inners[in].count >= k_min - 1)
+        return;
+
+      auto [up, uc] = p[h - 1];
+      auto& top     = inners[up];
+      auto& node    = inners[in];
+      if (uc > 0 && inners[top.children[uc - 1]].count > k_min - 1)
+      {
+        // rotate the last key of the left sibling through the parent
+        auto& left = inners[top.children[uc - 1]];
+        std::copy_backward(node.children.begin(), node.children.begin() + node.count + 1,
+                           node.children.begin() + node.count + 2);
+        node.children[0] = left.children[left.count];
+        insert_slot(node, 0, top.sizes[uc - 1], top.ids[uc - 1]);
+        top.sizes[uc - 1] = left.sizes[left.count - 1];
+        top.ids[uc - 1]   = left.ids[left.count - 1];
+        erase_slot(left, left.count - 1);
+        return;
+      }
+      if (uc < top.count && inners[top.children[uc + 1]].count > k_min - 1)
+      {
+        auto& right = inners[top.children[uc + 1]];
+        node.children[node.count + 1] = right.children[0];
+        insert_slot(node, node.count, top.sizes[uc], top.ids[uc]);
+        top.sizes[uc] = right.sizes[0];
+        top.ids[uc]   = right.ids[0];
+        std::copy(right.children.begin() + 1, right.children.begin() + right.count + 1, right.children.begin());
+        erase_slot(right, 0);
+        return;
+      }
+
+      // the separator comes down between the keys of the two merged nodes
+      auto  isep   = uc > 0 ? uc - 1 : uc;
+      auto  iri    = top.children[isep + 1];
+      auto& ileft  = inners[top.children[isep]];
+      auto& iright = inners[iri];
+      ileft.sizes[ileft.count] = top.sizes[isep];
+      ileft.ids[ileft.count]   = top.ids[isep];
+      std::copy(iright.sizes.begin(), iright.sizes.begin() + iright.count, ileft.sizes.begin() + ileft.count + 1);
+      std::copy(iright.ids.begin(), iright.ids.begin() + iright.count, ileft.ids.begin() + ileft.count + 1);
+      std::copy(iright.children.begin(), iright.children.begin() + iright.count + 1,
+                ileft.children.begin() + ileft.count + 1);
+      ileft.count += iright.count + 1;
+      inners.erase(iri);
+      erase_separator(top, isep);
+    }
+  }
+
+  // keys of the subtree at `n` lie in [lo, hi)
+  void validate_node(std::uint32_t n, std::uint32_t level, std::pair<size_type, std::uint32_t> const* lo,
+                     std::pair<size_type, std::uint32_t> const* hi) const
+  {
+    auto in_range = [&](size_type size, std::uint32_t id) {
+      return (!lo || !less(size, id, lo->first, lo->second)) && (!hi || less(size, id, hi->first, hi->second));
+    };
+    if (level == height)
+    {
+      for (std::uint32_t i = 0; i < leaves[n].count; ++i)
+        assert(in_range(leaves[n].sizes[i], leaves[n].ids[i]));
+      return;
+    }
+
+    auto const& inner = inners[n];
+    assert(n == root ? inner.count > 0 : inner.count >= k_min - 1);
+    for (std::uint32_t i = 0; i <= inner.count; ++i)
+    {
+      std::pair<size_type, std::uint32_t> left, right;
+      if (i > 0)
+        left = std::make_pair(inner.sizes[i - 1], inner.ids[i - 1]);
+      if (i < inner.count)
+      {
+        right = std::make_pair(inner.sizes[i], inner.ids[i]);
+        assert(in_range(right.first, right.second));
+      }
+      validate_node(inner.children[i], level + 1, i > 0 ? &left : lo, i < inner.count ? &right : hi);
+    }
+    for (std::uint32_t i = inner.count; i < k_width; ++i)
+      assert(inner.sizes[i] == k_null_sz<size_type>);
+  }
+
+  detail::table<leaf_node>  leaves;
+  detail::table<inner_node> inners;
+  std::uint32_t             root       = k_null_32;
+  std::uint32_t             first      = k_null_32;
+  std::uint32_t             height     = 0;
+  std::uint32_t             free_count = 0;
+};
+} // namespace cppalloc::detail
@@ -0,0 +1,345 @@
+﻿#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <detail/arena.hpp>
+
+namespace cppalloc::detail
+{
+//  ██████╗-██╗---██╗██████╗-██████╗-██╗---██╗
+//  ██╔══██╗██║---██║██╔══██╗██╔══██╗╚██╗-██╔╝
+//  ██████╔╝██║---██║██║--██║██║--██║-╚████╔╝-
+//  ██╔══██╗██║---██║██║--██║██║--██║--╚██╔╝--
+//  ██████╔╝╚██████╔╝██████╔╝██████╔╝---██║---
+//  ╚═════╝--╚═════╝-╚═════╝-╚═════╝----╚═╝---
+//  ------------------------------------------
+//! Binary buddy system.
+//!
+//! Allocations are rounded up to a power of two of at least k_min_size bytes and placed at an offset aligned to
+//! their size, splitting a larger free piece in halves. A released block is merged with its buddy, the other half of
+//! the piece it was split from, for as long as that one is free. The free pieces of an arena are bits, one bitmap per
+//! power of two with a summary of its non empty words, so a split or a merge is a bit operation per level and the
+//! allocator only keeps blocks for allocations. An arena is cut in the largest aligned pieces that fit, its last
+//! bytes stay unused if they do not make a piece.
+//!
+//! Free space has no blocks, so the allocator releases blocks through coalesce and never asks for free blocks. Blocks
+//! of an arena are not kept in offset order, they cannot be slid inside it and only move to other arenas.
+template <typename traits>
+class alloc_strategy_impl<alloc_strategy::buddy, traits>
+{
+public:
+  using size_type  = typename traits::size_type;
+  using block_bank = detail::block_bank<traits>;
+  using alloc_desc = cppalloc::alloc_desc<size_type>;
+  using bank_data  = detail::bank_data<traits>;
+
+  static constexpr std::uint32_t k_orders    = std::numeric_limits<size_type>::digits;
+  static constexpr std::uint32_t k_min_order = 4;
+  static constexpr size_type     k_min_size  = size_type(1) << k_min_order;
+
+  static_assert(k_orders <= 64, "order bitmap is 64 bits");
+
+  //! A free piece of an arena: its power of two and its index among the pieces of that size
+  struct position
+  {
+    std::uint32_t arena = k_null_32;
+    std::uint32_t order = 0;
+    size_type     index = 0;
+  };
+
+  //! Blocks are rounded up to a power of two and placed at an offset aligned to their size, so a request never needs
+  //! padding
+  static inline size_type request_size(alloc_desc const& desc)
+  {
+    return std::bit_ceil(std::max({desc.size(), desc.alignment_mask() + 1, k_min_size}));
+  }
+
+  inline position try_allocate([[maybe_unused]] bank_data& bank, size_type size)
+  {
+    auto          order  = ceil_order(size);
+    std::uint64_t larger = order < k_orders ? orders & (~std::uint64_t(0) << order) : 0;
+    if (!larger)
+      return position();
+
+    // the smallest piece that holds the request, in the first arena that has one
+    position found;
+    found.order = static_cast<std::uint32_t>(std::countr_zero(larger));
+    found.arena = static_cast<std::uint32_t>(first_set(arenas_with[found.order]));
+    found.index = arenas[found.arena].pieces[found.order - k_min_order].first();
+    return found;
+  }
+
+  inline bool is_valid(position const& it)
+  {
+    return it.arena != k_null_32;
+  }
+
+  //! Takes the piece and splits it down to the size of the request, the upper halves stay free
+  inline std::uint32_t commit(bank_data& bank, size_type size, position const& found)
+  {
+    if (!is_valid(found))
+      return k_null_32;
+
+    auto order = ceil_order(size);
+    auto index = found.index;
+    reset(found.arena, found.order, index);
+    for (auto o = found.order; o > order; --o)
+    {
+      index <<= 1;
+      set(found.arena, o - 1, index | 1);
+    }
+
+    size = size_type(1) << order;
+    arenas[found.arena].free -= size;
+    free_size -= size;
+    auto id = bank.blocks.emplace(index << order, size, found.arena);
+    bank.arenas[found.arena].block_order.push_back(bank.blocks, id);
+    return id;
+  }
+
+  //! Called by the allocator on deallocation, the block is erased and its piece merged with its free buddies
+  inline void coalesce(bank_data& bank, std::uint32_t node)
+  {
+    auto arena = bank.blocks[node].arena;
+    auto size  = bank.blocks[node].size;
+    auto order = ceil_order(size);
+    auto index = bank.blocks[node].offset >> order;
+    bank.arenas[arena].block_order.erase(bank.blocks, node);
+
+    auto& state = arenas[arena];
+    state.free += size;
+    free_size += size;
+    while (order + 1 < k_min_order + state.pieces.size() && test(arena, order, index ^ 1))
+    {
+      reset(arena, order, index ^ 1);
+      index >>= 1;
+      order++;
+    }
+    set(arena, order, index);
+  }
+
+  //! Cuts a new arena in pieces, an arena that is not empty is held whole by the block of a dedicated allocation
+  inline void add_arena(bank_data& bank, std::uint32_t arena, bool empty)
+  {
+    if (arenas.size() <= arena)
+      arenas.resize(arena + 1);
+
+    auto  size  = bank.arenas[arena].size;
+    auto& state = arenas[arena];
+    state       = arena_state();
+    assert(empty || (std::has_single_bit(size) && size >= k_min_size));
+    if (size >= k_min_size)
+    {
+      auto top = floor_order(size);
+      state.pieces.resize(top - k_min_order + 1);
+      for (auto o = k_min_order; o <= top; ++o)
+        state.pieces[o - k_min_order].resize(size >> o);
+    }
+    if (!empty)
+      return;
+
+    state.free = size;
+    free_size += size;
+    for (size_type offset = 0; size - offset >= k_min_size;)
+    {
+      auto order = floor_order(size - offset);
+      if (offset)
+        order = std::min(order, static_cast<std::uint32_t>(std::countr_zero(offset)));
+      set(arena, order, offset >> order);
+      offset += size_type(1) << order;
+    }
+  }
+
+  //! Forgets the free pieces of a dropped arena
+  inline void erase_arena(std::uint32_t arena)
+  {
+    exclude_arena(arena, true);
+    free_size -= arenas[arena].free;
+    arenas[arena] = arena_state();
+  }
+
+  //! While excluded, nothing is taken from the arena, its pieces are still merged on release
+  inline void exclude_arena(std::uint32_t arena, bool excluded)
+  {
+    auto& state = arenas[arena];
+    if (state.excluded == excluded)
+      return;
+    for (std::uint32_t o = 0; o < state.pieces.size(); ++o)
+      if (state.pieces[o].count)
+        excluded ? unlist(arena, o + k_min_order) : enlist(arena, o + k_min_order);
+    state.excluded = excluded;
+  }
+
+  //! Size of the largest free piece that is not excluded
+  inline size_type largest_free() const
+  {
+    return orders ? size_type(1) << (63 - std::countl_zero(orders)) : 0;
+  }
+
+  inline size_type total_free_size([[maybe_unused]] block_bank const& blocks) const
+  {
+    return free_size;
+  }
+
+  void validate_integrity(block_bank const& blocks)
+  {
+    size_type     total = 0;
+    std::uint64_t seen  = 0;
+    for (std::uint32_t arena = 0; arena < arenas.size(); ++arena)
+    {
+      auto const& state = arenas[arena];
+      size_type   free  = 0;
+      for (std::uint32_t o = 0; o < state.pieces.size(); ++o)
+      {
+        auto const& level = state.pieces[o];
+        size_type   count = 0;
+        for (std::size_t w = 0; w < level.words.size(); ++w)
+        {
+          count += static_cast<size_type>(std::popcount(level.words[w]));
+          assert(((level.summary[w >> 6] >> (w & 63)) & 1) == (level.words[w] != 0));
+        }
+        assert(count == level.count);
+        free += count << (o + k_min_order);
+        if (count && !state.excluded)
+        {
+          assert(test_arena(arena, o + k_min_order));
+          seen |= std::uint64_t(1) << (o + k_min_order);
+        }
+        else
+          assert(!test_arena(arena, o + k_min_order));
+      }
+      // the last bytes of an arena that make no piece count as free
+      assert(free <= state.free && state.free - free < k_min_size);
+      total += state.free;
+    }
+    assert(seen == orders);
+    assert(total == free_size);
+
+    // a block in use is no free piece, nor inside one
+    for (auto id : blocks)
+    {
+      auto const& blk = blocks[id];
+      if (blk.size == 0)
+        continue;
+      assert(std::has_single_bit(blk.size) && (blk.offset & (blk.size - 1)) == 0);
+      for (auto o = ceil_order(blk.size), index = blk.offset >> o; o < k_min_order + arenas[blk.arena].pieces.size();
+           ++o, index >>= 1)
+        assert(!test(blk.arena, o, index));
+    }
+  }
+
+private:
+  //! Bit per piece of one size, with a bit per non empty word to find the first free piece
+  struct level_bits
+  {
+    std::vector<std::uint64_t> words;
+    std::vector<std::uint64_t> summary;
+    size_type                  size  = 0;
+    size_type                  count = 0;
+
+    void resize(size_type pieces)
+    {
+      size = pieces;
+      words.assign(static_cast<std::size_t>((pieces + 63) >> 6), 0);
+      summary.assign((words.size() + 63) >> 6, 0);
+    }
+
+    size_type first() const
+    {
+      for (std::size_t s = 0;; ++s)
+        if (summary[s])
+        {
+          auto w = (s << 6) + static_cast<std::size_t>(std::countr_zero(summary[s]));
+          return static_cast<size_type>((w << 6) + static_cast<std::size_t>(std::countr_zero(words[w])));
+        }
+    }
+  };
+
+  struct arena_state
+  {
+    //! Pieces from k_min_order up to the largest power of two in the arena
+    std::vector<level_bits> pieces;
+    //! Bytes of the free pieces, and of the last bytes that make no piece
+    size_type               free     = 0;
+    bool                    excluded = false;
+  };
+
+  static inline std::uint32_t floor_order(size_type size)
+  {
+    return static_cast<std::uint32_t>(std::bit_width(size)) - 1;
+  }
+
+  static inline std::uint32_t ceil_order(size_type size)
+  {
+    return size <= k_min_size ? k_min_order
+                              : static_cast<std::uint32_t>(std::bit_width(static_cast<size_type>(size - 1)));
+  }
+
+  static inline std::size_t first_set(std::vector<std::uint64_t> const& bits)
+  {
+    for (std::size_t w = 0;; ++w)
+      if (bits[w])
+        return (w << 6) + static_cast<std::size_t>(std::countr_zero(bits[w]));
+  }
+
+  inline bool test(std::uint32_t arena, std::uint32_t order, size_type index) const
+  {
+    auto const& level = arenas[arena].pieces[order - k_min_order];
+    return index < level.size && ((level.words[index >> 6] >> (index & 63)) & 1);
+  }
+
+  inline void set(std::uint32_t arena, std::uint32_t order, size_type index)
+  {
+    auto& state = arenas[arena];
+    auto& level = state.pieces[order - k_min_order];
+    auto  w     = static_cast<std::size_t>(index >> 6);
+    level.words[w] |= std::uint64_t(1) << (index & 63);
+    level.summary[w >> 6] |= std::uint64_t(1) << (w & 63);
+    if (level.count++ == 0 && !state.excluded)
+      enlist(arena, order);
+  }
+
+  inline void reset(std::uint32_t arena, std::uint32_t order, size_type index)
+  {
+    auto& state = arenas[arena];
+    auto& level = state.pieces[order - k_min_order];
+    auto  w     = static_cast<std::size_t>(index >> 6);
+    level.words[w] &= ~(std::uint64_t(1) << (index & 63));
+    if (!level.words[w])
+      level.summary[w >> 6] &= ~(std::uint64_t(1) << (w & 63));
+    if (--level.count == 0 && !state.excluded)
+      unlist(arena, order);
+  }
+
+  inline bool test_arena(std::uint32_t arena, std::uint32_t order) const
+  {
+    auto const& bits = arenas_with[order];
+    return (arena >> 6) < bits.size() && ((bits[arena >> 6] >> (arena & 63)) & 1);
+  }
+
+  // the arena has pieces of the order
+  inline void enlist(std::uint32_t arena, std::uint32_t order)
+  {
+    auto& bits = arenas_with[order];
+    if (bits.size() <= (arena >> 6))
+      bits.resize((arena >> 6) + 1, 0);
+    bits[arena >> 6] |= std::uint64_t(1) << (arena & 63);
+    if (arena_count[order]++ == 0)
+      orders |= std::uint64_t(1) << order;
+  }
+
+  inline void unlist(std::uint32_t arena, std::uint32_t order)
+  {
+    arenas_with[order][arena >> 6] &= ~(std::uint64_t(1) << (arena & 63));
+    if (--arena_count[order] == 0)
+      orders &= ~(std::uint64_t(1) << order);
+  }
+
+  std::vector<arena_state>                          arenas;
+  //! Per order, a bit per arena that has a free piece of it, and the number of those arenas
+  std::array<std::vector<std::uint64_t>, k_orders> arenas_with;
+  std::array<std::uint32_t, k_orders>               arena_count = {};
+  std::uint64_t                                     orders      = 0;
+  size_type                                         free_size   = 0;
+};
+} // namespace cppalloc::detail
@@ -6,11 +6,13 @@
 #include <cassert>
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <limits>
 #include <new>
 #include <random>
+#include <span>
 #include <sstream>
 #include <string>
 #include <type_traits>
@@ -58,6 +60,15 @@
 #define CPPALLOC_VALIDITY_CHECKS
 #endif
 
+// stale handles are caught by validity checks, or on their own for release builds at the cost of fewer block ids
+#if defined(CPPALLOC_VALIDITY_CHECKS) && !defined(CPPALLOC_HANDLE_CHECKS)
+#define CPPALLOC_HANDLE_CHECKS
+#endif
+
+#ifndef CPPALLOC_STALE_HANDLE
+#define CPPALLOC_STALE_HANDLE(handle) cppalloc::detail::report_stale_handle(handle)
+#endif
+
 #ifndef CPPALLOC_PRINT_DEBUG
 #define CPPALLOC_PRINT_DEBUG(info) cppalloc::detail::print_debug_info(info)
 #endif
@@ -93,6 +104,12 @@ inline void print_debug_info(std::string const& s)
   std::cout << s;
 }
 
+[[noreturn]] inline void report_stale_handle(std::uint32_t handle)
+{
+  CPPALLOC_PRINT_DEBUG("Stale handle: " + std::to_string(handle) + "\n");
+  std::abort();
+}
+
 struct stats_base
 {
   static std::string print()
@@ -115,11 +132,11 @@ struct statistics : public base_t
   {
     return std::false_type{};
   }
-  static std::false_type report_allocate(std::size_t size)
+  static std::false_type report_allocate(std::size_t size, std::uint32_t count = 1)
   {
     return std::false_type{};
   }
-  static std::false_type report_deallocate(std::size_t size)
+  static std::false_type report_deallocate(std::size_t size, std::uint32_t count = 1)
   {
     return std::false_type{};
   }
@@ -235,16 +252,16 @@ struct statistics<tag_arg, true, base_arg, k_print> : public base_arg
     arenas_allocated += count;
   }
 
-  [[nodiscard]] timer_t::scoped report_allocate(std::size_t size)
+  [[nodiscard]] timer_t::scoped report_allocate(std::size_t size, std::uint32_t count = 1)
   {
-    allocation_count++;
+    allocation_count += count;
     allocation += size;
     peak_allocation = std::max<std::size_t>(allocation.load(), peak_allocation.load());
     return timer_t::scoped(allocation_timing);
   }
-  [[nodiscard]] timer_t::scoped report_deallocate(std::size_t size)
+  [[nodiscard]] timer_t::scoped report_deallocate(std::size_t size, std::uint32_t count = 1)
   {
-    deallocation_count++;
+    deallocation_count += count;
     allocation -= size;
     return timer_t::scoped(deallocation_timing);
   }
@@ -143,7 +143,7 @@ private:
       return node;
     }
 
-    value_type const& value() const
+    decltype(auto) value() const
     {
       return Accessor::value(*ref);
     }
@@ -444,6 +444,23 @@ public:
     return 0;
   }
 
+  //! Next node in order, 0 after the last one
+  std::uint32_t successor(container const& cont, std::uint32_t node) const
+  {
+    if (node == 0)
+      return 0;
+    cnode_it u(cont, node);
+    if (u.right() != 0)
+      return minimum(cont, u.right(cont)).index();
+    std::uint32_t parent = u.parent();
+    while (parent != 0 && Accessor::links(Accessor::node(cont, parent)).right == node)
+    {
+      node   = parent;
+      parent = Accessor::links(Accessor::node(cont, node)).parent;
+    }
+    return parent;
+  }
+
   std::uint32_t lower_bound(container& cont, value_type ivalue) const
   {
     return lower_bound(cont, root, ivalue);
@@ -0,0 +1,58 @@
+#pragma once
+#include <detail/cppalloc_common.hpp>
+
+#if defined(CPPALLOC_USE_SSE_AVX) && defined(__AVX2__)
+#include <immintrin.h>
+#define CPPALLOC_HAS_AVX2
+#endif
+
+#if defined(CPPALLOC_USE_SSE_AVX) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define CPPALLOC_HAS_SSE2
+#endif
+
+namespace cppalloc::detail
+{
+
+//! Number of keys in `keys[0, count)` that are less than `value`, which is the lower bound of `value` when the keys
+//! are sorted. Unsigned 64 bit keys are compared 4 at a time with AVX2 and 32 bit keys with SSE2, when
+//! CPPALLOC_USE_SSE_AVX is defined.
+template <typename size_type>
+inline std::uint32_t count_less(size_type const* keys, std::uint32_t count, size_type value)
+{
+  static_assert(std::is_unsigned_v<size_type>, "keys are unsigned sizes");
+
+  std::uint32_t i      = 0;
+  std::uint32_t result = 0;
+#if defined(CPPALLOC_HAS_AVX2)
+  if constexpr (sizeof(size_type) == 8)
+  {
+    // signed compare on keys with the top bit flipped
+    auto bias = _mm256_set1_epi64x(std::numeric_limits<std::int64_t>::min());
+    auto v    = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<std::int64_t>(value)), bias);
+    for (; i + 4 <= count; i += 4)
+    {
+      auto k = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(keys + i)), bias);
+      result += CPPALLOC_POPCOUNT(
+          static_cast<std::uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, k)))));
+    }
+  }
+#endif
+#if defined(CPPALLOC_HAS_SSE2)
+  if constexpr (sizeof(size_type) == 4)
+  {
+    auto bias = _mm_set1_epi32(std::numeric_limits<std::int32_t>::min());
+    auto v    = _mm_xor_si128(_mm_set1_epi32(static_cast<std::int32_t>(value)), bias);
+    for (; i + 4 <= count; i += 4)
+    {
+      auto k = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(keys + i)), bias);
+      result += CPPALLOC_POPCOUNT(static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(k, v)))));
+    }
+  }
+#endif
+  for (; i < count; ++i)
+    result += keys[i] < value ? 1 : 0;
+  return result;
+}
+
+} // namespace cppalloc::detail
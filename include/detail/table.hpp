@@ -1,40 +1,234 @@
 #pragma once
+#include <bit>
 #include <detail/cppalloc_common.hpp>
+#include <iterator>
+#include <memory>
 #include <type_traits>
 
 namespace cppalloc::detail
 {
 
+//! Elements in pages of 2^k_page_bits, adding or dropping a page never moves the others
+template <typename T, std::uint32_t k_page_bits>
+class paged_array
+{
+public:
+  static constexpr std::uint32_t k_page_size = 1u << k_page_bits;
+
+  paged_array()                                  = default;
+  paged_array(paged_array&&) noexcept            = default;
+  paged_array& operator=(paged_array&&) noexcept = default;
+  paged_array(paged_array const& other)
+  {
+    *this = other;
+  }
+
+  paged_array& operator=(paged_array const& other)
+  {
+    if (this == &other)
+      return *this;
+    shrink(other.capacity());
+    reserve(other.capacity());
+    for (std::size_t p = 0; p < pages.size(); ++p)
+      std::copy(other.pages[p].get(), other.pages[p].get() + k_page_size, pages[p].get());
+    return *this;
+  }
+
+  T& operator[](std::uint32_t i)
+  {
+    return pages[i >> k_page_bits][i & (k_page_size - 1)];
+  }
+
+  T const& operator[](std::uint32_t i) const
+  {
+    return pages[i >> k_page_bits][i & (k_page_size - 1)];
+  }
+
+  std::uint32_t capacity() const
+  {
+    return static_cast<std::uint32_t>(pages.size()) << k_page_bits;
+  }
+
+  //! Pages are added until `count` elements fit
+  void reserve(std::uint32_t count)
+  {
+    while (capacity() < count)
+      pages.emplace_back(new T[k_page_size]());
+  }
+
+  //! Pages past the first `count` elements are freed
+  void shrink(std::uint32_t count)
+  {
+    auto kept = (static_cast<std::size_t>(count) + k_page_size - 1) >> k_page_bits;
+    if (kept < pages.size())
+      pages.resize(kept);
+  }
+
+private:
+  std::vector<std::unique_ptr<T[]>> pages;
+};
+
+//! Elements addressed by index, erased slots are reused. Elements live in pages of about 16 KiB that are never moved,
+//! so growing the table does not copy it and references stay valid until their element is erased. Every page keeps
+//! its erased slots in a list of its own, and new elements go to the lowest page with a free slot, so the elements in
+//! use gather in the first pages and the last ones can be freed by shrink_to_fit. A bitmap with a bit per slot marks
+//! the elements in use, begin() and end() walk it a word at a time to visit them in index order.
+//! With CPPALLOC_HANDLE_CHECKS every slot counts how often it was erased or renewed, and handle() packs that count in
+//! the low bits of the index so index() can tell a handle that outlived its element. Without it handles are the
+//! indices and both calls compile away.
 template <typename T>
 class table
 {
 public:
+#ifdef CPPALLOC_HANDLE_CHECKS
+  //! Bits of a handle that hold the generation of its slot
+  static constexpr std::uint32_t k_generation_bits = 8;
+#else
+  static constexpr std::uint32_t k_generation_bits = 0;
+#endif
+  static constexpr std::uint32_t k_page_bits =
+      std::countr_zero(std::bit_floor(std::max<std::size_t>(16384 / sizeof(T), 64)));
+
+  //! Indices of the elements in use in increasing order, skipping 64 erased slots per step
+  class index_iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = std::uint32_t;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = std::uint32_t const*;
+    using reference         = std::uint32_t;
+
+    index_iterator() = default;
+    index_iterator(table const& owner, std::uint32_t word) : owner(&owner), word(word)
+    {
+      if (word < owner.word_count())
+        seek(owner.occupied[word]);
+    }
+
+    std::uint32_t operator*() const
+    {
+      return (word << 6) + static_cast<std::uint32_t>(std::countr_zero(bits));
+    }
+
+    index_iterator& operator++()
+    {
+      seek(bits & (bits - 1));
+      return *this;
+    }
+
+    index_iterator operator++(int)
+    {
+      auto ret = *this;
+      ++(*this);
+      return ret;
+    }
+
+    bool operator==(index_iterator const& other) const
+    {
+      return word == other.word && bits == other.bits;
+    }
+
+  private:
+    void seek(std::uint64_t next)
+    {
+      auto words = owner->word_count();
+      while (!next && ++word < words)
+        next = owner->occupied[word];
+      bits = next;
+    }
+
+    table const*  owner = nullptr;
+    std::uint32_t word  = 0;
+    std::uint64_t bits  = 0;
+  };
+
   template <typename... Args>
   std::uint32_t emplace(Args&&... args)
   {
     std::uint32_t index = 0;
-    if (unused != k_null_32)
+    auto          page  = unused_page();
+    if (page != k_null_32)
     {
-      index  = unused;
-      unused = reinterpret_cast<std::uint32_t&>(pool[unused]);
+      index             = page_unused[page];
+      page_unused[page] = reinterpret_cast<std::uint32_t&>(pool[index]);
+      if (page_unused[page] == k_null_32)
+        unused_pages[page >> 6] &= ~(std::uint64_t(1) << (page & 63));
     }
     else
     {
-      index = static_cast<std::uint32_t>(pool.size());
-      pool.resize(index + 1);
+      index = extent++;
+      assert(index < (k_null_32 >> k_generation_bits));
+      grow(extent);
     }
     new (&pool[index]) T(std::forward<Args>(args)...);
+    occupied[index >> 6] |= std::uint64_t(1) << (index & 63);
     valids++;
     return index;
   }
 
   void erase(std::uint32_t index)
   {
+    assert(contains(index));
     auto& t = reinterpret_cast<T&>(pool[index]);
     t.~T();
-    reinterpret_cast<std::uint32_t&>(pool[index]) = unused;
-    unused                                        = index;
+    auto page                                     = index >> k_page_bits;
+    reinterpret_cast<std::uint32_t&>(pool[index]) = page_unused[page];
+    page_unused[page]                             = index;
+    unused_pages[page >> 6] |= std::uint64_t(1) << (page & 63);
+    lowest_unused = std::min(lowest_unused, page);
+    occupied[index >> 6] &= ~(std::uint64_t(1) << (index & 63));
     valids--;
+    renew(index);
+  }
+
+  //! Handles given out for the element at `index` so far no longer refer to it
+  void renew([[maybe_unused]] std::uint32_t index)
+  {
+#ifdef CPPALLOC_HANDLE_CHECKS
+    generations[index]++;
+#endif
+  }
+
+  //! For a table rebuilt to replace `previous`, before it gives out any handle: handles given out by `previous` are
+  //! stale in this one
+  void supersede([[maybe_unused]] table const& previous)
+  {
+#ifdef CPPALLOC_HANDLE_CHECKS
+    generations.reserve(previous.extent);
+    for (std::uint32_t i = 0; i < previous.extent; ++i)
+      generations[i] = static_cast<std::uint8_t>(previous.generations[i] + 1);
+#endif
+  }
+
+  std::uint32_t handle(std::uint32_t index) const
+  {
+#ifdef CPPALLOC_HANDLE_CHECKS
+    return (index << k_generation_bits) | generations[index];
+#else
+    return index;
+#endif
+  }
+
+  //! Index of a handle, one that outlived its element is reported through CPPALLOC_STALE_HANDLE
+  std::uint32_t index(std::uint32_t handle) const
+  {
+#ifdef CPPALLOC_HANDLE_CHECKS
+    if (CPPALLOC_UNLIKELY(!is_current(handle)))
+      CPPALLOC_STALE_HANDLE(handle);
+#endif
+    return handle >> k_generation_bits;
+  }
+
+  //! False for a handle of an erased or renewed element, always true without CPPALLOC_HANDLE_CHECKS
+  bool is_current([[maybe_unused]] std::uint32_t handle) const
+  {
+#ifdef CPPALLOC_HANDLE_CHECKS
+    auto index = handle >> k_generation_bits;
+    return index < extent && generations[index] == (handle & ((1u << k_generation_bits) - 1));
+#else
+    return true;
+#endif
   }
 
   T& operator[](std::uint32_t i)
@@ -52,16 +246,121 @@ public:
     return valids;
   }
 
+  //! True if the slot at `index` holds an element
+  bool contains(std::uint32_t index) const
+  {
+    return index < extent && (occupied[index >> 6] >> (index & 63)) & 1;
+  }
+
+  index_iterator begin() const
+  {
+    return index_iterator(*this, 0);
+  }
+
+  index_iterator end() const
+  {
+    return index_iterator(*this, word_count());
+  }
+
+  //! One past the highest index handed out
+  std::uint32_t end_index() const
+  {
+    return extent;
+  }
+
+  //! Pages for `count` elements are added ahead
+  void reserve(std::uint32_t count)
+  {
+    pool.reserve(count);
+    occupied.reserve((count + 63) >> 6);
+#ifdef CPPALLOC_HANDLE_CHECKS
+    generations.reserve(count);
+#endif
+  }
+
+  //! Frees the pages after the last one with an element in use. Handles of slots in those pages are no longer told
+  //! apart from the ones given out when the slots are used again.
+  void shrink_to_fit()
+  {
+    auto pages = page_count(extent);
+    while (pages > 0 && is_empty_page(pages - 1))
+      pages--;
+    extent = std::min(extent, pages << k_page_bits);
+    page_unused.resize(pages);
+    unused_pages.resize((pages + 63) >> 6);
+    if (pages & 63)
+      unused_pages.back() &= (std::uint64_t(1) << (pages & 63)) - 1;
+    pool.shrink(extent);
+    occupied.shrink(word_count());
+#ifdef CPPALLOC_HANDLE_CHECKS
+    generations.shrink(extent);
+#endif
+  }
+
 private:
+  static std::uint32_t page_count(std::uint32_t count)
+  {
+    return (count + (1u << k_page_bits) - 1) >> k_page_bits;
+  }
+
+  std::uint32_t word_count() const
+  {
+    return (extent + 63) >> 6;
+  }
+
+  bool is_empty_page(std::uint32_t page) const
+  {
+    auto first = page << (k_page_bits - 6);
+    for (auto word = first; word < first + (1u << (k_page_bits - 6)); ++word)
+      if (occupied[word])
+        return false;
+    return true;
+  }
+
+  //! Lowest page with an erased slot, searched from the lowest page an element was erased from
+  std::uint32_t unused_page()
+  {
+    for (auto word = lowest_unused >> 6; word < unused_pages.size(); ++word)
+    {
+      if (unused_pages[word])
+      {
+        lowest_unused = (word << 6) + std::countr_zero(unused_pages[word]);
+        return lowest_unused;
+      }
+    }
+    lowest_unused = k_null_32;
+    return k_null_32;
+  }
+
+  void grow(std::uint32_t count)
+  {
+    reserve(count);
+    auto pages = page_count(count);
+    if (page_unused.size() < pages)
+    {
+      page_unused.resize(pages, k_null_32);
+      unused_pages.resize((pages + 63) >> 6, 0);
+    }
+  }
+
 #ifdef CPPALLOC_VALIDITY_CHECKS
   using storage = T;
 #else
-  // Note: Alignment is controlled by the allocator.
-  using storage = std::aligned_storage_t<sizeof(T)>;
+  using storage = std::aligned_storage_t<sizeof(T), alignof(T)>;
+#endif
+  paged_array<storage, k_page_bits>           pool;
+  // one bit per slot, set while it holds an element
+  paged_array<std::uint64_t, k_page_bits - 6> occupied;
+#ifdef CPPALLOC_HANDLE_CHECKS
+  paged_array<std::uint8_t, k_page_bits>      generations;
 #endif
-  std::vector<storage> pool;
-  std::uint32_t        unused = k_null_32;
-  std::uint32_t        valids = 0;
+  // per page, the head of its erased slots linked through the slots
+  std::vector<std::uint32_t>                  page_unused;
+  // pages with erased slots, one bit each
+  std::vector<std::uint64_t>                  unused_pages;
+  std::uint32_t                               lowest_unused = k_null_32;
+  std::uint32_t                               extent        = 0;
+  std::uint32_t                               valids        = 0;
 };
 
 } // namespace cppalloc::detail
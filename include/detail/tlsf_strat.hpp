@@ -0,0 +1,229 @@
+﻿#pragma once
+#include <array>
+#include <bit>
+#include <detail/arena.hpp>
+
+namespace cppalloc::detail
+{
+template <>
+struct block_ext<alloc_strategy::tlsf>
+{
+  using type = cppalloc::detail::list_node;
+};
+
+//  ████████╗██╗-----███████╗███████╗
+//  ╚══██╔══╝██║-----██╔════╝██╔════╝
+//  ---██║---██║-----███████╗█████╗--
+//  ---██║---██║-----╚════██║██╔══╝--
+//  ---██║---███████╗███████║██║-----
+//  ---╚═╝---╚══════╝╚══════╝╚═╝-----
+//  ---------------------------------
+//! Two-level segregated fit.
+//!
+//! Free blocks are kept in lists per size class: the first level is the power of two of the size, the second level
+//! splits it in k_sl_count linear classes. A bitmap per level records the non empty lists, so finding a free block
+//! that fits, inserting and removing one are constant time. Requests are rounded up to the next class so that any
+//! block of the found list fits. Blocks of the request's own class that are large enough are not searched, the
+//! allocator adds an arena instead, which keeps the worst case bounded.
+template <typename traits>
+class alloc_strategy_impl<alloc_strategy::tlsf, traits>
+{
+public:
+  using size_type  = typename traits::size_type;
+  using arena_bank = detail::arena_bank<traits>;
+  using block_bank = detail::block_bank<traits>;
+  using block      = detail::block<traits>;
+  using alloc_desc = cppalloc::alloc_desc<size_type>;
+  using bank_data  = detail::bank_data<traits>;
+
+  static constexpr std::uint32_t k_sl_bits  = 5;
+  static constexpr std::uint32_t k_sl_count = 1u << k_sl_bits;
+  static constexpr std::uint32_t k_fl_count = std::numeric_limits<size_type>::digits - k_sl_bits + 1;
+
+  static_assert(k_fl_count <= 64, "first level bitmap is 64 bits");
+
+  alloc_strategy_impl()
+  {
+    for (auto& fl : heads)
+      fl.fill(k_null_32);
+  }
+
+  inline std::uint32_t try_allocate([[maybe_unused]] bank_data& bank, size_type size)
+  {
+    // a request so large that rounding overflows is left to a new arena
+    auto rounded = round_up(size);
+    if (rounded < size)
+      return k_null_32;
+    auto [fl, sl] = mapping(rounded);
+    return find_suitable(fl, sl);
+  }
+
+  //! Smallest free block try_allocate(size) is sure to find, the allocator sizes new arenas with it
+  static inline size_type fit_size(size_type size)
+  {
+    auto rounded = round_up(size);
+    if (rounded < size || rounded < k_sl_count)
+      return size;
+    return rounded & ~((size_type(1) << (log2(rounded) - k_sl_bits)) - 1);
+  }
+
+  inline std::uint32_t commit(bank_data& bank, size_type size, std::uint32_t found)
+  {
+    if (found == k_null_32)
+      return k_null_32;
+
+    auto& blk = bank.blocks[found];
+    unlink(bank.blocks, found);
+    blk.is_free    = false;
+    auto remaining = blk.size - size;
+    blk.size       = size;
+    if (remaining > 0)
+    {
+      auto& list   = bank.arenas[blk.arena].block_order;
+      auto  arena  = blk.arena;
+      auto  newblk = bank.blocks.emplace(blk.offset + size, remaining, arena, detail::k_null_sz<uhandle>, true);
+      list.insert_after(bank.blocks, found, newblk);
+      link(bank.blocks, newblk);
+    }
+    return found;
+  }
+
+  inline void add_free_arena([[maybe_unused]] block_bank& blocks, std::uint32_t block)
+  {
+    link(blocks, block);
+  }
+  inline void add_free(block_bank& blocks, std::uint32_t block)
+  {
+    link(blocks, block);
+  }
+  inline void replace(block_bank& blocks, std::uint32_t block, std::uint32_t new_block, size_type new_size)
+  {
+    unlink(blocks, block);
+    blocks[new_block].size = new_size;
+    link(blocks, new_block);
+  }
+  inline std::uint32_t node(std::uint32_t it)
+  {
+    return it;
+  }
+  inline bool is_valid(std::uint32_t it)
+  {
+    return it != k_null_32;
+  }
+  inline void erase(block_bank& blocks, std::uint32_t node)
+  {
+    unlink(blocks, node);
+  }
+
+  inline std::uint32_t total_free_nodes(block_bank const& blocks) const
+  {
+    std::uint32_t count = 0;
+    for (auto const& fl : heads)
+      for (auto it : fl)
+        for (; it != k_null_32; it = blocks[it].ext.next)
+          count++;
+    return count;
+  }
+
+  inline size_type total_free_size(block_bank const& blocks) const
+  {
+    size_type sz = 0;
+    for (auto const& fl : heads)
+      for (auto it : fl)
+        for (; it != k_null_32; it = blocks[it].ext.next)
+          sz += blocks[it].size;
+    return sz;
+  }
+
+  void validate_integrity(block_bank const& blocks)
+  {
+    for (std::uint32_t fl = 0; fl < k_fl_count; ++fl)
+    {
+      assert(((fl_bitmap >> fl) & 1) == (sl_bitmap[fl] != 0));
+      for (std::uint32_t sl = 0; sl < k_sl_count; ++sl)
+      {
+        assert(((sl_bitmap[fl] >> sl) & 1) == (heads[fl][sl] != k_null_32));
+        std::uint32_t prev = k_null_32;
+        for (auto it = heads[fl][sl]; it != k_null_32; prev = it, it = blocks[it].ext.next)
+        {
+          assert(blocks[it].ext.prev == prev);
+          assert(mapping(blocks[it].size) == std::make_pair(fl, sl));
+        }
+      }
+    }
+  }
+
+private:
+  // up to the next class, so any block of its list fits
+  static inline size_type round_up(size_type size)
+  {
+    return size >= k_sl_count ? size + (size_type(1) << (log2(size) - k_sl_bits)) - 1 : size;
+  }
+
+  static inline std::uint32_t log2(size_type size)
+  {
+    return static_cast<std::uint32_t>(std::bit_width(size)) - 1;
+  }
+
+  static inline std::pair<std::uint32_t, std::uint32_t> mapping(size_type size)
+  {
+    if (size < k_sl_count)
+      return std::make_pair(0u, static_cast<std::uint32_t>(size));
+    auto l = log2(size);
+    return std::make_pair(l - k_sl_bits + 1, static_cast<std::uint32_t>(size >> (l - k_sl_bits)) - k_sl_count);
+  }
+
+  // head of the first non empty list at class (fl, sl) or above
+  inline std::uint32_t find_suitable(std::uint32_t fl, std::uint32_t sl) const
+  {
+    std::uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map)
+    {
+      std::uint64_t fl_map = fl + 1 < 64 ? fl_bitmap & (~std::uint64_t(0) << (fl + 1)) : 0;
+      if (!fl_map)
+        return k_null_32;
+      fl     = static_cast<std::uint32_t>(std::countr_zero(fl_map));
+      sl_map = sl_bitmap[fl];
+    }
+    return heads[fl][std::countr_zero(sl_map)];
+  }
+
+  inline void link(block_bank& blocks, std::uint32_t id)
+  {
+    auto [fl, sl] = mapping(blocks[id].size);
+    auto& head    = heads[fl][sl];
+    auto& ext     = blocks[id].ext;
+    ext.prev      = k_null_32;
+    ext.next      = head;
+    if (head != k_null_32)
+      blocks[head].ext.prev = id;
+    head = id;
+    sl_bitmap[fl] |= 1u << sl;
+    fl_bitmap |= std::uint64_t(1) << fl;
+  }
+
+  inline void unlink(block_bank& blocks, std::uint32_t id)
+  {
+    auto [fl, sl] = mapping(blocks[id].size);
+    auto& ext     = blocks[id].ext;
+    if (ext.prev != k_null_32)
+      blocks[ext.prev].ext.next = ext.next;
+    else
+      heads[fl][sl] = ext.next;
+    if (ext.next != k_null_32)
+      blocks[ext.next].ext.prev = ext.prev;
+    ext = list_node();
+
+    if (heads[fl][sl] == k_null_32)
+    {
+      sl_bitmap[fl] &= ~(1u << sl);
+      if (!sl_bitmap[fl])
+        fl_bitmap &= ~(std::uint64_t(1) << fl);
+    }
+  }
+
+  std::array<std::array<std::uint32_t, k_sl_count>, k_fl_count> heads;
+  std::array<std::uint32_t, k_fl_count>                         sl_bitmap = {};
+  std::uint64_t                                                 fl_bitmap = 0;
+};
+} // namespace cppalloc::detail
\ No newline at end of file
@@ -0,0 +1,251 @@
+#pragma once
+#include <alloc_desc.hpp>
+#include <functional>
+#include <memory_move_executor.hpp>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#if defined(CPPALLOC_USE_SSE_AVX) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define CPPALLOC_HAS_STREAM_COPY
+#endif
+
+namespace cppalloc
+{
+namespace detail
+{
+inline void* map_pages(std::size_t size)
+{
+#if defined(_WIN32)
+  return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+  void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return ptr == MAP_FAILED ? nullptr : ptr;
+#endif
+}
+
+inline void unmap_pages(void* ptr, [[maybe_unused]] std::size_t size)
+{
+#if defined(_WIN32)
+  VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+  munmap(ptr, size);
+#endif
+}
+
+// keeps the address range, gives the physical pages back
+inline void discard_pages(void* ptr, std::size_t size)
+{
+#if defined(_WIN32)
+  VirtualAlloc(ptr, size, MEM_RESET, PAGE_READWRITE);
+#else
+  madvise(ptr, size, MADV_DONTNEED);
+#endif
+}
+
+//! memmove that bypasses the cache with streaming stores when a large copy does not overlap
+inline void stream_copy(void* dst, void const* src, std::size_t size)
+{
+#ifdef CPPALLOC_HAS_STREAM_COPY
+  constexpr std::size_t k_stream_threshold = 256 * 1024;
+
+  auto d = static_cast<char*>(dst);
+  auto s = static_cast<char const*>(src);
+  if (size >= k_stream_threshold && (d + size <= s || s + size <= d))
+  {
+    std::size_t head = (16 - (reinterpret_cast<std::uintptr_t>(d) & 15)) & 15;
+    std::memcpy(d, s, head);
+    d += head;
+    s += head;
+    size -= head;
+    for (; size >= 64; size -= 64, d += 64, s += 64)
+    {
+      auto a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s));
+      auto b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + 16));
+      auto c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + 32));
+      auto e = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + 48));
+      _mm_stream_si128(reinterpret_cast<__m128i*>(d), a);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), b);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), c);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), e);
+    }
+    _mm_sfence();
+    std::memcpy(d, s, size);
+    return;
+  }
+#endif
+  std::memmove(dst, src, size);
+}
+} // namespace detail
+
+//! Arena manager backed by host memory.
+//!
+//! Every arena is mapped from the OS on its own. Empty arenas are unmapped, or kept with their pages given back
+//! (MADV_DONTNEED) up to `max_cached_arenas` of them to be reused by the next arenas of the same size. Allocations
+//! are resolved to addresses with `resolve`. Defragmentation moves run on a memory_move_executor with streaming
+//! stores for large copies, rebinds are forwarded to the `on_rebind` callback.
+template <typename size_type = std::size_t>
+class host_arena_manager
+{
+public:
+  using alloc_info  = cppalloc::alloc_info<size_type>;
+  using memory_move = cppalloc::memory_move<size_type>;
+  using rebind_info = cppalloc::rebind_info<size_type>;
+  using rebind_fn   = std::function<void(uhandle huser, alloc_info const& info)>;
+
+  //! `move_threads` threads copy memory during defragmentation, counting the thread that defragments
+  explicit host_arena_manager(std::uint32_t max_cached_arenas = 4, std::uint32_t move_threads = 1)
+      : max_cached(max_cached_arenas), executor(move_threads)
+  {
+  }
+
+  ~host_arena_manager()
+  {
+    for (auto& a : arenas)
+      if (a.base)
+        detail::unmap_pages(a.base, a.size);
+    for (auto& a : cached)
+      detail::unmap_pages(a.base, a.size);
+  }
+
+  host_arena_manager(host_arena_manager const&) = delete;
+  host_arena_manager& operator=(host_arena_manager const&) = delete;
+
+  //! Called for every allocation moved by a defragmentation
+  inline void set_rebind_callback(rebind_fn fn)
+  {
+    on_rebind = std::move(fn);
+  }
+
+  inline void* resolve(alloc_info const& info) const
+  {
+    return static_cast<char*>(arenas[info.harena].base) + info.offset;
+  }
+
+  inline void* arena_base(uhandle harena) const
+  {
+    return arenas[harena].base;
+  }
+
+  //! Bytes currently mapped for live arenas
+  inline std::size_t mapped_size() const
+  {
+    return mapped;
+  }
+
+  uhandle add_arena([[maybe_unused]] ihandle id, size_type size)
+  {
+    arena a;
+    a.size     = static_cast<std::size_t>(size);
+    auto reuse = std::find_if(cached.begin(), cached.end(), [&](arena const& c) {
+      return c.size == a.size;
+    });
+    if (reuse != cached.end())
+    {
+      a = *reuse;
+      cached.erase(reuse);
+    }
+    else
+      a.base = detail::map_pages(a.size);
+
+    if (!a.base)
+      throw std::bad_alloc();
+    mapped += a.size;
+
+    uhandle h = detail::k_null_32;
+    if (free_handles.empty())
+    {
+      h = static_cast<uhandle>(arenas.size());
+      arenas.push_back(a);
+    }
+    else
+    {
+      h = free_handles.back();
+      free_handles.pop_back();
+      arenas[h] = a;
+    }
+    return h;
+  }
+
+  bool drop_arena(uhandle h)
+  {
+    release(h);
+    return true;
+  }
+
+  void remove_arena(uhandle h)
+  {
+    release(h);
+  }
+
+  template <typename allocator>
+  void begin_defragment([[maybe_unused]] allocator& a)
+  {
+  }
+
+  template <typename allocator>
+  void end_defragment([[maybe_unused]] allocator& a)
+  {
+  }
+
+  void move_memory(uhandle src_arena, uhandle dst_arena, size_type from, size_type to, size_type size)
+  {
+    detail::stream_copy(static_cast<char*>(arenas[dst_arena].base) + to,
+                        static_cast<char const*>(arenas[src_arena].base) + from, static_cast<std::size_t>(size));
+  }
+
+  void move_memory(std::span<memory_move const> moves)
+  {
+    executor.execute(
+        moves,
+        [this](uhandle h) {
+          return arenas[h].base;
+        },
+        &detail::stream_copy);
+  }
+
+  void rebind_alloc(uhandle huser, alloc_info info)
+  {
+    if (on_rebind)
+      on_rebind(huser, info);
+  }
+
+private:
+  struct arena
+  {
+    void*       base = nullptr;
+    std::size_t size = 0;
+  };
+
+  inline void release(uhandle h)
+  {
+    auto& a = arenas[h];
+    mapped -= a.size;
+    if (cached.size() < max_cached)
+    {
+      detail::discard_pages(a.base, a.size);
+      cached.push_back(a);
+    }
+    else
+      detail::unmap_pages(a.base, a.size);
+    a = arena();
+    free_handles.push_back(h);
+  }
+
+  std::vector<arena>              arenas;
+  std::vector<arena>              cached;
+  std::vector<uhandle>            free_handles;
+  std::size_t                     mapped = 0;
+  std::uint32_t                   max_cached;
+  memory_move_executor<size_type> executor;
+  rebind_fn                       on_rebind;
+};
+
+} // namespace cppalloc
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <arena_growth.hpp>
 #include <linear_allocator.hpp>
 
 namespace cppalloc
@@ -14,10 +15,11 @@ class linear_arena_allocator
     : public detail::statistics<linear_arena_allocator_tag, k_compute_stats, underlying_allocator>
 {
 public:
-  using tag        = linear_arena_allocator_tag;
-  using statistics = detail::statistics<linear_arena_allocator_tag, k_compute_stats, underlying_allocator>;
-  using size_type  = typename underlying_allocator::size_type;
-  using address    = typename underlying_allocator::address;
+  using tag          = linear_arena_allocator_tag;
+  using statistics   = detail::statistics<linear_arena_allocator_tag, k_compute_stats, underlying_allocator>;
+  using size_type    = typename underlying_allocator::size_type;
+  using address      = typename underlying_allocator::address;
+  using arena_growth = cppalloc::arena_growth<size_type>;
 
   enum : size_type
   {
@@ -26,7 +28,7 @@ public:
 
   template <typename... Args>
   explicit linear_arena_allocator(size_type i_arena_size, Args&&... i_args)
-      : k_arena_size(i_arena_size), statistics(std::forward<Args>(i_args)...), current_arena(0)
+      : statistics(std::forward<Args>(i_args)...), current_arena(0), growth(i_arena_size)
   {
     // Initializing the cursor is important for the
     // allocate loop to work.
@@ -76,8 +78,7 @@ public:
 
     if (ret_value == null())
     {
-      size_type max_arena_size = std::max<size_type>(i_size, k_arena_size);
-      ret_value                = allocate_from(index = allocate_new_arena(max_arena_size), i_size);
+      ret_value = allocate_from(index = allocate_new_arena(growth.grow(i_size)), i_size);
     }
 
     if (i_alignment)
@@ -139,6 +140,7 @@ public:
     for (size_type index = current_arena + 1, end = static_cast<size_type>(arenas.size()); index < end; ++index)
     {
       underlying_allocator::deallocate(arenas[index].buffer, arenas[index].arena_size);
+      growth.shrink();
     }
     arenas.resize(current_arena + 1);
     current_arena = 0;
@@ -158,6 +160,12 @@ public:
     return static_cast<std::uint32_t>(arenas.size());
   }
 
+  //! Sizes of the arenas added from now on, smart_rewind shrinks them back for every arena it frees
+  void set_arena_growth(arena_growth const& policy)
+  {
+    growth = policy;
+  }
+
 private:
   struct arena
   {
@@ -201,7 +209,7 @@ private:
   std::vector<arena> arenas;
   size_type          current_arena;
 
-  const size_type k_arena_size;
+  arena_growth growth;
 
 public:
 };
@@ -2,6 +2,7 @@
 // Created by obhi on 11/17/20.
 //
 #pragma once
+#include <arena_growth.hpp>
 #include <limits>
 #include <linear_allocator.hpp>
 
@@ -17,10 +18,11 @@ class linear_stack_allocator
     : public detail::statistics<linear_stack_allocator_tag, k_compute_stats, underlying_allocator>
 {
 public:
-  using tag        = linear_stack_allocator_tag;
-  using statistics = detail::statistics<linear_stack_allocator_tag, k_compute_stats, underlying_allocator>;
-  using size_type  = typename underlying_allocator::size_type;
-  using address    = typename underlying_allocator::address;
+  using tag          = linear_stack_allocator_tag;
+  using statistics   = detail::statistics<linear_stack_allocator_tag, k_compute_stats, underlying_allocator>;
+  using size_type    = typename underlying_allocator::size_type;
+  using address      = typename underlying_allocator::address;
+  using arena_growth = cppalloc::arena_growth<size_type>;
 
   enum : size_type
   {
@@ -56,7 +58,7 @@ public:
 
   template <typename... Args>
   explicit linear_stack_allocator(size_type i_arena_size, Args&&... i_args)
-      : k_arena_size(i_arena_size), statistics(std::forward<Args>(i_args)...), current_arena(0)
+      : statistics(std::forward<Args>(i_args)...), current_arena(0), growth(i_arena_size)
   {
     // Initializing the cursor is important for the
     // allocate loop to work.
@@ -120,8 +122,7 @@ public:
 
     if (ret_value == null())
     {
-      size_type max_arena_size = std::max<size_type>(i_size, k_arena_size);
-      ret_value                = allocate_from(index = allocate_new_arena(max_arena_size), i_size);
+      ret_value = allocate_from(index = allocate_new_arena(growth.grow(i_size)), i_size);
     }
 
     if (i_alignment)
@@ -154,6 +155,7 @@ public:
     for (size_type index = current_arena + 1, end = static_cast<size_type>(arenas.size()); index < end; ++index)
     {
       underlying_allocator::deallocate(arenas[index].buffer, arenas[index].arena_size);
+      growth.shrink();
     }
     arenas.resize(current_arena + 1);
     current_arena = 0;
@@ -173,6 +175,12 @@ public:
     return static_cast<std::uint32_t>(arenas.size());
   }
 
+  //! Sizes of the arenas added from now on, smart_rewind shrinks them back for every arena it frees
+  void set_arena_growth(arena_growth const& policy)
+  {
+    growth = policy;
+  }
+
   inline void rewind(rewind_point marker)
   {
     current_arena = marker.arena;
@@ -226,7 +234,7 @@ private:
   std::vector<arena> arenas;
   size_type          current_arena = 0;
 
-  const size_type k_arena_size;
+  arena_growth growth;
 
 public:
 };
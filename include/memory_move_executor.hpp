@@ -0,0 +1,262 @@
+#pragma once
+#include <alloc_desc.hpp>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace cppalloc
+{
+namespace detail
+{
+//! Tracks the last writer and the readers since then of every byte range of one arena, to find which earlier moves
+//! a move has to wait for
+template <typename size_type>
+class move_dependencies
+{
+public:
+  inline void read(std::uint32_t task, size_type begin, size_type end, std::vector<std::uint32_t>& deps)
+  {
+    auto range = cover(begin, end);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (it->second.writer != k_null_32)
+        deps.push_back(it->second.writer);
+      it->second.readers.push_back(task);
+    }
+  }
+
+  inline void write(std::uint32_t task, size_type begin, size_type end, std::vector<std::uint32_t>& deps)
+  {
+    auto range = cover(begin, end);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (it->second.writer != k_null_32)
+        deps.push_back(it->second.writer);
+      deps.insert(deps.end(), it->second.readers.begin(), it->second.readers.end());
+    }
+    segments.erase(range.first, range.second);
+    segments.emplace(begin, segment{end, task, {}});
+  }
+
+private:
+  struct segment
+  {
+    size_type                  end    = 0;
+    std::uint32_t              writer = k_null_32;
+    std::vector<std::uint32_t> readers;
+  };
+  using segment_map = std::map<size_type, segment>;
+
+  inline void split(size_type at)
+  {
+    auto it = segments.upper_bound(at);
+    if (it == segments.begin())
+      return;
+    --it;
+    if (it->first < at && at < it->second.end)
+    {
+      segment right  = it->second;
+      it->second.end = at;
+      segments.emplace_hint(std::next(it), at, std::move(right));
+    }
+  }
+
+  // segments exactly covering [begin, end)
+  inline std::pair<typename segment_map::iterator, typename segment_map::iterator> cover(size_type begin,
+                                                                                         size_type end)
+  {
+    split(begin);
+    split(end);
+    size_type pos = begin;
+    for (auto it = segments.lower_bound(begin); pos < end;)
+    {
+      if (it == segments.end() || it->first > pos)
+      {
+        auto gap_end = it == segments.end() ? end : std::min(end, it->first);
+        it           = segments.emplace_hint(it, pos, segment{gap_end, k_null_32, {}});
+      }
+      pos = it->second.end;
+      ++it;
+    }
+    return std::make_pair(segments.lower_bound(begin), segments.lower_bound(end));
+  }
+
+  segment_map segments;
+};
+} // namespace detail
+
+//! Performs the memory moves of a defragmentation on several threads.
+//!
+//! Moves are split in chunks, then every chunk waits only for the earlier chunks whose source or destination range
+//! it overlaps, so the result is the same as performing the moves one after the other in their order. Chunks that
+//! do not depend on each other, like moves between different arenas, are copied concurrently by a small pool of
+//! threads owned by the executor, the calling thread takes part too. One execute may run at a time.
+template <typename size_type = std::size_t>
+class memory_move_executor
+{
+public:
+  using memory_move = cppalloc::memory_move<size_type>;
+  //! Copies a chunk, source and destination may overlap
+  using copy_fn = void (*)(void* dst, void const* src, std::size_t size);
+
+  //! `threads` counts the calling thread, moves are cut in chunks of `chunk_size` bytes
+  explicit memory_move_executor(std::uint32_t threads    = std::thread::hardware_concurrency(),
+                                size_type     chunk_size = size_type(1) << 20u)
+      : chunk(std::max<size_type>(chunk_size, 1))
+  {
+    for (std::uint32_t i = 1; i < threads; ++i)
+      workers.emplace_back([this]() {
+        work();
+      });
+  }
+
+  ~memory_move_executor()
+  {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stop = true;
+    }
+    wake.notify_all();
+    for (auto& w : workers)
+      w.join();
+  }
+
+  memory_move_executor(memory_move_executor const&) = delete;
+  memory_move_executor& operator=(memory_move_executor const&) = delete;
+
+  //! Perform the moves, `arena_base(uhandle)` returns the address of an arena. Returns once all moves are done.
+  template <typename resolver>
+  void execute(std::span<memory_move const> moves, resolver&& arena_base, copy_fn copy = &default_copy)
+  {
+    if (moves.empty())
+      return;
+
+    build(moves, arena_base);
+    std::unique_lock<std::mutex> guard(lock);
+    copier    = copy;
+    remaining = static_cast<std::uint32_t>(tasks.size());
+    for (std::uint32_t i = 0; i < tasks.size(); ++i)
+      if (tasks[i].waits_for == 0)
+        ready.push_back(i);
+    wake.notify_all();
+
+    while (remaining)
+    {
+      if (ready.empty())
+        wake.wait(guard);
+      else
+        run(guard);
+    }
+  }
+
+  inline std::uint32_t thread_count() const
+  {
+    return static_cast<std::uint32_t>(workers.size()) + 1;
+  }
+
+private:
+  struct task
+  {
+    std::byte*                 dst       = nullptr;
+    std::byte const*           src       = nullptr;
+    size_type                  size      = 0;
+    std::uint32_t              waits_for = 0;
+    std::vector<std::uint32_t> next;
+  };
+
+  static void default_copy(void* dst, void const* src, std::size_t size)
+  {
+    std::memmove(dst, src, size);
+  }
+
+  template <typename resolver>
+  inline void build(std::span<memory_move const> moves, resolver& arena_base)
+  {
+    std::size_t count = 0;
+    for (auto const& m : moves)
+      count += (m.size + chunk - 1) / chunk;
+    tasks = std::vector<task>(count);
+
+    std::unordered_map<uhandle, detail::move_dependencies<size_type>> arenas;
+    std::vector<std::uint32_t>                                         deps;
+    std::uint32_t                                                      id = 0;
+    for (auto const& m : moves)
+    {
+      auto src = reinterpret_cast<std::byte const*>(arena_base(m.arena_src));
+      auto dst = reinterpret_cast<std::byte*>(arena_base(m.arena_dst));
+      // a move to the right inside an arena is cut from its end, so chunks in order give the same result
+      bool backwards = m.arena_src == m.arena_dst && m.to > m.from;
+      for (size_type done_size = 0; done_size < m.size; done_size += chunk, ++id)
+      {
+        size_type size   = std::min(chunk, m.size - done_size);
+        size_type offset = backwards ? m.size - done_size - size : done_size;
+        auto&     t      = tasks[id];
+        t.src            = src + m.from + offset;
+        t.dst            = dst + m.to + offset;
+        t.size           = size;
+
+        deps.clear();
+        arenas[m.arena_src].read(id, m.from + offset, m.from + offset + size, deps);
+        arenas[m.arena_dst].write(id, m.to + offset, m.to + offset + size, deps);
+        std::sort(deps.begin(), deps.end());
+        deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+        for (auto d : deps)
+        {
+          if (d == id)
+            continue;
+          tasks[d].next.push_back(id);
+          t.waits_for++;
+        }
+      }
+    }
+  }
+
+  // runs one ready task, called with the lock held
+  inline void run(std::unique_lock<std::mutex>& guard)
+  {
+    auto id = ready.front();
+    ready.pop_front();
+    guard.unlock();
+
+    auto& t = tasks[id];
+    copier(t.dst, t.src, static_cast<std::size_t>(t.size));
+
+    guard.lock();
+    bool released = false;
+    for (auto n : t.next)
+      if (--tasks[n].waits_for == 0)
+      {
+        ready.push_back(n);
+        released = true;
+      }
+    if (--remaining == 0 || released)
+      wake.notify_all();
+  }
+
+  inline void work()
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    while (!stop)
+    {
+      if (ready.empty())
+        wake.wait(guard);
+      else
+        run(guard);
+    }
+  }
+
+  std::vector<task>         tasks;
+  std::deque<std::uint32_t> ready;
+  std::uint32_t             remaining = 0;
+  copy_fn                   copier    = &default_copy;
+  std::mutex                lock;
+  std::condition_variable   wake;
+  bool                      stop = false;
+  std::vector<std::thread>  workers;
+  size_type                 chunk;
+};
+
+} // namespace cppalloc
@@ -0,0 +1,71 @@
+#include "performance.hpp"
+
+namespace
+{
+using namespace perf;
+
+constexpr std::uint32_t k_rounds     = 2000;
+constexpr std::uint32_t k_batch_size = 256;
+
+// load and unload batches of blocks, half of every batch outlives it
+template <cppalloc::alloc_strategy strategy, bool batched>
+double run_batches()
+{
+  manager_t                                                       mgr;
+  cppalloc::arena_allocator<manager_t, std::size_t, strategy>     allocator(4 * 1024 * 1024, mgr);
+  std::minstd_rand                                                gen;
+  std::uniform_int_distribution<std::size_t>                      size_gen(16, 4096);
+  std::vector<alloc_desc>                                         descs;
+  std::vector<alloc_info>                                         infos(k_batch_size);
+  std::vector<cppalloc::ihandle>                                  released;
+  std::vector<cppalloc::ihandle>                                  kept;
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::uint32_t round = 0; round < k_rounds; ++round)
+  {
+    descs.clear();
+    for (std::uint32_t i = 0; i < k_batch_size; ++i)
+      descs.emplace_back(size_gen(gen), 16, i);
+
+    if constexpr (batched)
+      allocator.allocate(descs, infos);
+    else
+      for (std::uint32_t i = 0; i < k_batch_size; ++i)
+        infos[i] = allocator.allocate(descs[i]);
+
+    released.clear();
+    for (std::uint32_t i = 0; i < k_batch_size; ++i)
+      (i & 1 ? released : kept).push_back(infos[i].halloc);
+    if (round & 1)
+    {
+      released.insert(released.end(), kept.begin(), kept.end());
+      kept.clear();
+    }
+
+    if constexpr (batched)
+      allocator.deallocate(released);
+    else
+      for (auto h : released)
+        allocator.deallocate(h);
+  }
+  auto elapsed = to_seconds(std::chrono::steady_clock::now() - start);
+  return (2.0 * k_rounds * k_batch_size) / elapsed / 1e6;
+}
+
+template <cppalloc::alloc_strategy strategy>
+void print(char const* name)
+{
+  auto single  = run_batches<strategy, false>();
+  auto batched = run_batches<strategy, true>();
+  std::cout << std::setw(13) << name << " | " << std::setw(13) << std::fixed << std::setprecision(2) << single << " | "
+            << std::setw(13) << batched << " | " << std::setw(7) << batched / single << "\n";
+}
+} // namespace
+
+TEST_CASE("Batch allocation of arena_allocator", "[arena_allocator][performance]")
+{
+  std::cout << "     strategy | single (Mops/s) | batch (Mops/s) | speedup\n";
+  for_each_strategy([](auto strategy, char const* name) {
+    print<decltype(strategy)::value>(name);
+  });
+}
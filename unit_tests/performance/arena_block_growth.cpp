@@ -0,0 +1,52 @@
+#include "performance.hpp"
+
+namespace
+{
+using namespace perf;
+
+constexpr std::uint32_t k_blocks = 2000000;
+
+// time every allocation while the block bank grows to a few million blocks, growth shows in the tail latencies
+template <cppalloc::alloc_strategy strategy>
+std::vector<double> run_growth(std::uint32_t reserved)
+{
+  using clock = std::chrono::steady_clock;
+
+  manager_t                                                   mgr;
+  cppalloc::arena_allocator<manager_t, std::size_t, strategy> allocator(64 * 1024 * 1024, mgr);
+  std::minstd_rand                                            gen;
+  std::uniform_int_distribution<std::size_t>                  size_gen(16, 256);
+  std::vector<cppalloc::ihandle>                              live(k_blocks);
+  std::vector<double>                                         latencies(k_blocks);
+  allocator.reserve_blocks(reserved);
+
+  for (std::uint32_t i = 0; i < k_blocks; ++i)
+  {
+    auto start   = clock::now();
+    live[i]      = allocator.allocate(alloc_desc(size_gen(gen), 8, i)).halloc;
+    latencies[i] = to_ns(clock::now() - start);
+  }
+  allocator.deallocate(live);
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+template <cppalloc::alloc_strategy strategy>
+void print(char const* name, std::uint32_t reserved)
+{
+  auto latencies = run_growth<strategy>(reserved);
+  auto at        = [&](double q) { return latencies[static_cast<std::size_t>(q * (latencies.size() - 1))]; };
+  std::cout << std::setw(13) << name << " | " << std::setw(8) << (reserved ? "yes" : "no") << " | " << std::setw(8)
+            << std::fixed << std::setprecision(1) << at(0.5) << " | " << std::setw(10) << at(0.9999) << " | "
+            << std::setw(10) << latencies.back() / 1000.0 << "\n";
+}
+} // namespace
+
+TEST_CASE("Allocation latency of arena_allocator while the block bank grows", "[arena_allocator][performance]")
+{
+  std::cout << "     strategy | reserved | p50 (ns) | p99.99 (ns) | max (us)\n";
+  print<cppalloc::alloc_strategy::best_fit_tree>("best_fit_tree", 0);
+  print<cppalloc::alloc_strategy::best_fit_tree>("best_fit_tree", k_blocks + 1024);
+  print<cppalloc::alloc_strategy::tlsf>("tlsf", 0);
+  print<cppalloc::alloc_strategy::tlsf>("tlsf", k_blocks + 1024);
+}
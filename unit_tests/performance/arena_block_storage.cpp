@@ -0,0 +1,86 @@
+#include "performance.hpp"
+
+namespace
+{
+using namespace perf;
+
+constexpr std::uint32_t k_live_blocks = 1000000;
+constexpr std::uint32_t k_churn       = 250000;
+
+struct storage_result
+{
+  double      allocate_ns   = 0;
+  double      deallocate_ns = 0;
+  std::size_t hot_bytes     = 0;
+  std::size_t block_bytes   = 0;
+};
+
+// fill an allocator with a million live blocks, then free and allocate blocks at random among them
+template <cppalloc::alloc_strategy strategy>
+storage_result run_live_blocks()
+{
+  using allocator_t = cppalloc::arena_allocator<manager_t, std::size_t, strategy>;
+  using traits      = cppalloc::detail::arena_allocator_traits<manager_t, std::size_t, strategy, false>;
+  using clock       = std::chrono::steady_clock;
+
+  manager_t                                    mgr;
+  allocator_t                                  allocator(16 * 1024 * 1024, mgr);
+  std::minstd_rand                             gen;
+  std::uniform_int_distribution<std::size_t>   size_gen(16, 256);
+  std::uniform_int_distribution<std::uint32_t> slot_gen(0, k_live_blocks - 1);
+  std::vector<cppalloc::ihandle>               live(k_live_blocks);
+
+  storage_result result;
+  clock::duration allocating{}, deallocating{};
+  auto            start = clock::now();
+  for (std::uint32_t i = 0; i < k_live_blocks; ++i)
+    live[i] = allocator.allocate(alloc_desc(size_gen(gen), 8, i)).halloc;
+  allocating += clock::now() - start;
+
+  std::vector<std::uint32_t> slots(k_churn);
+  for (auto& s : slots)
+    s = slot_gen(gen);
+  std::sort(slots.begin(), slots.end());
+  slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+  std::shuffle(slots.begin(), slots.end(), gen);
+
+  start = clock::now();
+  for (auto s : slots)
+    allocator.deallocate(live[s]);
+  deallocating += clock::now() - start;
+
+  start = clock::now();
+  for (auto s : slots)
+    live[s] = allocator.allocate(alloc_desc(size_gen(gen), 8, s)).halloc;
+  allocating += clock::now() - start;
+
+  start = clock::now();
+  for (auto h : live)
+    allocator.deallocate(h);
+  deallocating += clock::now() - start;
+
+  auto ops             = static_cast<double>(k_live_blocks + slots.size());
+  result.allocate_ns   = to_ns(allocating) / ops;
+  result.deallocate_ns = to_ns(deallocating) / ops;
+  result.hot_bytes     = sizeof(cppalloc::detail::block<traits>);
+  result.block_bytes   = result.hot_bytes + sizeof(cppalloc::detail::block_info);
+  return result;
+}
+
+template <cppalloc::alloc_strategy strategy>
+void print(char const* name)
+{
+  auto r = run_live_blocks<strategy>();
+  std::cout << std::setw(13) << name << " | " << std::setw(9) << std::fixed << std::setprecision(1) << r.allocate_ns
+            << " | " << std::setw(11) << r.deallocate_ns << " | " << std::setw(9) << r.hot_bytes << " | "
+            << std::setw(13) << r.block_bytes << "\n";
+}
+} // namespace
+
+TEST_CASE("Block storage of arena_allocator with a million live blocks", "[arena_allocator][performance]")
+{
+  std::cout << "     strategy | alloc (ns) | dealloc (ns) | hot bytes | bytes / block\n";
+  for_each_strategy([](auto strategy, char const* name) {
+    print<decltype(strategy)::value>(name);
+  });
+}
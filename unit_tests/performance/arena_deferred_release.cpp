@@ -0,0 +1,77 @@
+#include "performance.hpp"
+
+namespace
+{
+using namespace perf;
+
+constexpr std::uint32_t k_live_blocks    = 2048;
+constexpr std::uint32_t k_request_blocks = 1024;
+constexpr std::uint32_t k_rounds         = 300;
+
+// a request allocates a thousand blocks among long lived ones and tears them all down in random order
+template <cppalloc::alloc_strategy strategy>
+std::pair<double, double> run_teardown(std::uint32_t deferred_blocks)
+{
+  manager_t                                                   mgr;
+  cppalloc::arena_allocator<manager_t, std::size_t, strategy> allocator(1024 * 1024, mgr);
+  std::minstd_rand                                            gen;
+  std::uniform_int_distribution<std::size_t>                  size_gen(16, 256);
+  std::vector<cppalloc::ihandle>                              live, request;
+  allocator.set_deferred_release(deferred_blocks);
+
+  for (std::uint32_t i = 0; i < k_live_blocks; ++i)
+    live.push_back(allocator.allocate(alloc_desc(size_gen(gen), 8, i)).halloc);
+
+  using clock = std::chrono::steady_clock;
+  clock::duration allocating{}, releasing{};
+  for (std::uint32_t round = 0; round < k_rounds; ++round)
+  {
+    auto start = clock::now();
+    for (std::uint32_t i = 0; i < k_request_blocks; ++i)
+    {
+      request.push_back(allocator.allocate(alloc_desc(size_gen(gen), 8, i)).halloc);
+      // a few outlive the request, in place of long lived blocks that go
+      if (i % 64 == 0)
+      {
+        auto slot = std::uniform_int_distribution<std::size_t>(0, live.size() - 1)(gen);
+        allocator.deallocate(live[slot]);
+        live[slot] = request.back();
+        request.pop_back();
+      }
+    }
+    std::shuffle(request.begin(), request.end(), gen);
+    auto teardown = clock::now();
+    for (auto h : request)
+      allocator.deallocate(h);
+    request.clear();
+    auto end = clock::now();
+    allocating += teardown - start;
+    releasing += end - teardown;
+  }
+
+  for (auto h : live)
+    allocator.deallocate(h);
+  auto per_block = [](clock::duration d) {
+    return to_ns(d) / (double(k_rounds) * k_request_blocks);
+  };
+  return {per_block(allocating), per_block(releasing)};
+}
+
+template <cppalloc::alloc_strategy strategy>
+void print(char const* name)
+{
+  auto eager    = run_teardown<strategy>(0);
+  auto deferred = run_teardown<strategy>(k_request_blocks);
+  std::cout << std::setw(13) << name << " | " << std::setw(11) << std::fixed << std::setprecision(1) << eager.first
+            << " | " << std::setw(10) << eager.second << " | " << std::setw(14) << deferred.first << " | "
+            << std::setw(13) << deferred.second << "\n";
+}
+} // namespace
+
+TEST_CASE("Deferred release of arena_allocator tearing down requests", "[arena_allocator][performance]")
+{
+  std::cout << "     strategy | alloc (ns) | free (ns) | deferred alloc | deferred free\n";
+  for_each_strategy([](auto strategy, char const* name) {
+    print<decltype(strategy)::value>(name);
+  });
+}
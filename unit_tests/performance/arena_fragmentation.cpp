@@ -0,0 +1,104 @@
+#include "performance.hpp"
+
+namespace
+{
+using namespace perf;
+
+constexpr std::uint32_t k_ops        = 1000000;
+constexpr std::uint32_t k_live_slots = 4096;
+constexpr std::size_t   k_arena_size = 64 * 1024;
+
+struct counting_manager : cppalloc::memory_manager_adapter<std::size_t>
+{
+  std::uint32_t arenas = 0;
+  std::uint32_t peak   = 0;
+
+  bool drop_arena([[maybe_unused]] cppalloc::uhandle id)
+  {
+    arenas--;
+    return true;
+  }
+
+  cppalloc::uhandle add_arena(cppalloc::ihandle id, [[maybe_unused]] std::size_t size)
+  {
+    peak = std::max(peak, ++arenas);
+    return id;
+  }
+};
+
+struct fragmentation_result
+{
+  double        mean_fragmentation = 0;
+  double        mean_utilization   = 0;
+  std::uint32_t peak_arenas        = 0;
+};
+
+// long randomized workload, live blocks are replaced at random with sizes spread over several powers of two, or
+// taken from a few size classes
+template <cppalloc::alloc_strategy strategy>
+fragmentation_result run_workload(bool size_classes)
+{
+  using allocator_t = cppalloc::arena_allocator<counting_manager, std::size_t, strategy>;
+  using slot_t      = std::pair<cppalloc::ihandle, std::size_t>;
+
+  counting_manager                             mgr;
+  allocator_t                                  allocator(k_arena_size, mgr);
+  std::minstd_rand                             gen;
+  std::uniform_int_distribution<std::uint32_t> order_gen(4, 12);
+  std::uniform_int_distribution<std::uint32_t> slot_gen(0, k_live_slots - 1);
+  std::vector<slot_t>                          live(k_live_slots, slot_t(cppalloc::detail::k_null_32, 0));
+
+  fragmentation_result result;
+  std::size_t          live_bytes = 0;
+  std::uint32_t        samples    = 0;
+  for (std::uint32_t op = 0; op < k_ops; ++op)
+  {
+    auto& slot = live[slot_gen(gen)];
+    if (slot.first != cppalloc::detail::k_null_32)
+    {
+      allocator.deallocate(slot.first);
+      live_bytes -= slot.second;
+      slot.first = cppalloc::detail::k_null_32;
+    }
+    else
+    {
+      auto order  = order_gen(gen);
+      auto sizes  = std::uniform_int_distribution<std::size_t>(std::size_t(1) << (order - 1), std::size_t(1) << order);
+      auto size   = size_classes ? sizes.b() : sizes(gen);
+      slot.first  = allocator.allocate(alloc_desc(size, 8, op)).halloc;
+      slot.second = size;
+      live_bytes += size;
+    }
+
+    if (op % 1000 == 999)
+    {
+      result.mean_fragmentation += allocator.fragmentation();
+      result.mean_utilization += static_cast<double>(live_bytes) / static_cast<double>(mgr.arenas * k_arena_size);
+      samples++;
+    }
+  }
+  result.mean_fragmentation /= samples;
+  result.mean_utilization /= samples;
+  result.peak_arenas = mgr.peak;
+  return result;
+}
+
+void print(char const* name, fragmentation_result const& r)
+{
+  std::cout << std::setw(13) << name << " | " << std::setw(13) << std::fixed << std::setprecision(3)
+            << r.mean_fragmentation << " | " << std::setw(12) << r.mean_utilization << " | " << std::setw(11)
+            << r.peak_arenas << "\n";
+}
+} // namespace
+
+TEST_CASE("Fragmentation of arena_allocator strategies", "[arena_allocator][performance]")
+{
+  for (bool size_classes : {false, true})
+  {
+    std::cout << (size_classes ? "size classes\n" : "mixed sizes\n");
+    std::cout << "     strategy | fragmentation | utilization | peak arenas\n";
+    for_each_strategy([&](auto strategy, char const* name) {
+      print(name, run_workload<decltype(strategy)::value>(size_classes));
+    });
+  }
+}
@@ -0,0 +1,54 @@
+#include "performance.hpp"
+
+namespace
+{
+using namespace perf;
+
+constexpr std::uint32_t k_blocks = 8192;
+constexpr std::uint32_t k_rounds = 200000;
+
+// leave every other block of a full arena free, then keep replacing the remaining blocks at random among them
+template <cppalloc::alloc_strategy strategy>
+double run_free_search()
+{
+  manager_t                                                   mgr;
+  cppalloc::arena_allocator<manager_t, std::size_t, strategy> allocator(4 * 1024 * 1024, mgr);
+  std::minstd_rand                                            gen;
+  std::uniform_int_distribution<std::size_t>                  size_gen(16, 256);
+  std::vector<cppalloc::ihandle>                              blocks(k_blocks);
+
+  for (std::uint32_t i = 0; i < k_blocks; ++i)
+    blocks[i] = allocator.allocate(alloc_desc(size_gen(gen), 8, i)).halloc;
+  for (std::uint32_t i = 0; i < k_blocks; i += 2)
+    allocator.deallocate(blocks[i]);
+
+  std::uniform_int_distribution<std::uint32_t> slot_gen(0, k_blocks / 2 - 1);
+  auto                                         start = std::chrono::steady_clock::now();
+  for (std::uint32_t i = 0; i < k_rounds; ++i)
+  {
+    auto slot = 2 * slot_gen(gen) + 1;
+    allocator.deallocate(blocks[slot]);
+    blocks[slot] = allocator.allocate(alloc_desc(size_gen(gen), 8, slot)).halloc;
+  }
+  auto elapsed = to_ns(std::chrono::steady_clock::now() - start);
+
+  for (std::uint32_t i = 1; i < k_blocks; i += 2)
+    allocator.deallocate(blocks[i]);
+  return elapsed / k_rounds;
+}
+
+template <cppalloc::alloc_strategy strategy>
+void print(char const* name)
+{
+  std::cout << std::setw(13) << name << " | " << std::setw(17) << std::fixed << std::setprecision(1)
+            << run_free_search<strategy>() << "\n";
+}
+} // namespace
+
+TEST_CASE("Free block search of arena_allocator with a few thousand free blocks", "[arena_allocator][performance]")
+{
+  std::cout << "     strategy | free + alloc (ns)\n";
+  for_each_strategy([](auto strategy, char const* name) {
+    print<decltype(strategy)::value>(name);
+  });
+}
@@ -0,0 +1,57 @@
+#include "performance.hpp"
+
+namespace
+{
+using namespace perf;
+
+constexpr std::uint32_t k_live_blocks = 4096;
+constexpr std::uint32_t k_rounds      = 500000;
+
+// keep a few thousand blocks of a handful of sizes alive, replacing one at random every round
+template <cppalloc::alloc_strategy strategy>
+double run_recurring_sizes(std::uint32_t cached_blocks)
+{
+  constexpr std::size_t k_sizes[] = {16, 32, 48, 64, 96, 128, 256};
+
+  manager_t                                                   mgr;
+  cppalloc::arena_allocator<manager_t, std::size_t, strategy> allocator(1024 * 1024, mgr);
+  std::minstd_rand                                            gen;
+  std::uniform_int_distribution<std::size_t>                  size_gen(0, std::size(k_sizes) - 1);
+  std::uniform_int_distribution<std::uint32_t>                slot_gen(0, k_live_blocks - 1);
+  std::vector<cppalloc::ihandle>                              live(k_live_blocks);
+  allocator.set_front_cache(cached_blocks);
+
+  for (std::uint32_t i = 0; i < k_live_blocks; ++i)
+    live[i] = allocator.allocate(alloc_desc(k_sizes[size_gen(gen)], 16, i)).halloc;
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::uint32_t i = 0; i < k_rounds; ++i)
+  {
+    auto slot = slot_gen(gen);
+    allocator.deallocate(live[slot]);
+    live[slot] = allocator.allocate(alloc_desc(k_sizes[size_gen(gen)], 16, slot)).halloc;
+  }
+  auto elapsed = to_ns(std::chrono::steady_clock::now() - start);
+
+  for (auto h : live)
+    allocator.deallocate(h);
+  return elapsed / k_rounds;
+}
+
+template <cppalloc::alloc_strategy strategy>
+void print(char const* name)
+{
+  auto uncached = run_recurring_sizes<strategy>(0);
+  auto cached   = run_recurring_sizes<strategy>(256);
+  std::cout << std::setw(13) << name << " | " << std::setw(13) << std::fixed << std::setprecision(1) << uncached
+            << " | " << std::setw(10) << cached << " | " << std::setw(7) << uncached / cached << "\n";
+}
+} // namespace
+
+TEST_CASE("Front cache of arena_allocator with recurring sizes", "[arena_allocator][performance]")
+{
+  std::cout << "     strategy | no cache (ns) | cache (ns) | speedup\n";
+  for_each_strategy([](auto strategy, char const* name) {
+    print<decltype(strategy)::value>(name);
+  });
+}
@@ -0,0 +1,82 @@
+#include "performance.hpp"
+#include <mutex>
+#include <thread>
+
+namespace
+{
+using namespace perf;
+
+constexpr std::uint32_t k_ops_per_thread = 200000;
+constexpr std::uint32_t k_live_blocks    = 256;
+
+template <typename Allocator, typename Lock>
+void run_thread(Allocator& allocator, Lock&& lock, std::uint32_t thread_id)
+{
+  std::minstd_rand                           gen(thread_id + 1);
+  std::uniform_int_distribution<std::size_t> size_gen(16, 512);
+  std::uniform_int_distribution<std::size_t> slot_gen(0, k_live_blocks - 1);
+  std::vector<cppalloc::ihandle>             live(k_live_blocks, cppalloc::detail::k_null_32);
+
+  for (std::uint32_t op = 0; op < k_ops_per_thread; ++op)
+  {
+    auto& slot = live[slot_gen(gen)];
+    if (slot != cppalloc::detail::k_null_32)
+    {
+      auto guard = lock();
+      allocator.deallocate(slot);
+      slot = cppalloc::detail::k_null_32;
+    }
+    else
+    {
+      auto guard = lock();
+      slot       = allocator.allocate(alloc_desc(size_gen(gen), 8, thread_id)).halloc;
+    }
+  }
+
+  for (auto h : live)
+  {
+    if (h != cppalloc::detail::k_null_32)
+    {
+      auto guard = lock();
+      allocator.deallocate(h);
+    }
+  }
+}
+
+template <typename Body>
+double measure_mops(std::uint32_t thread_count, Body&& body)
+{
+  std::vector<std::thread> threads;
+  auto                     start = std::chrono::steady_clock::now();
+  for (std::uint32_t t = 0; t < thread_count; ++t)
+    threads.emplace_back(body, t);
+  for (auto& t : threads)
+    t.join();
+  auto elapsed = to_seconds(std::chrono::steady_clock::now() - start);
+  return (static_cast<double>(thread_count) * k_ops_per_thread) / elapsed / 1e6;
+}
+} // namespace
+
+TEST_CASE("Scaling of concurrent_arena_allocator", "[concurrent_arena_allocator][performance]")
+{
+  std::cout << "threads | mutex + arena_allocator (Mops/s) | concurrent_arena_allocator (Mops/s)\n";
+  for (std::uint32_t thread_count = 1; thread_count <= 64; thread_count *= 2)
+  {
+    manager_t mgr;
+
+    cppalloc::arena_allocator<manager_t> locked(1024 * 1024, mgr);
+    std::mutex                           mutex;
+    double locked_mops = measure_mops(thread_count, [&](std::uint32_t id) {
+      run_thread(locked, [&mutex]() { return std::unique_lock<std::mutex>(mutex); }, id);
+    });
+
+    cppalloc::concurrent_arena_allocator<manager_t> sharded(1024 * 1024, mgr);
+    double sharded_mops = measure_mops(thread_count, [&](std::uint32_t id) {
+      run_thread(sharded, []() { return 0; }, id);
+    });
+
+    std::cout << std::setw(7) << thread_count << " | " << std::setw(32) << std::fixed << std::setprecision(2)
+              << locked_mops << " | " << std::setw(35) << sharded_mops << "\n";
+    CHECK(sharded_mops > 0);
+  }
+}
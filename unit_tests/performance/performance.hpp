@@ -0,0 +1,39 @@
+#pragma once
+#include <algorithm>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cppalloc.hpp>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <type_traits>
+
+//! Shared by the performance tests, which print one table row per allocation strategy
+namespace perf
+{
+using manager_t  = cppalloc::memory_manager_adapter<std::size_t>;
+using alloc_desc = cppalloc::alloc_desc<std::size_t>;
+using alloc_info = cppalloc::alloc_info<std::size_t>;
+
+inline double to_ns(std::chrono::steady_clock::duration d)
+{
+  return std::chrono::duration<double, std::nano>(d).count();
+}
+
+inline double to_seconds(std::chrono::steady_clock::duration d)
+{
+  return std::chrono::duration<double>(d).count();
+}
+
+//! Calls fn(std::integral_constant<alloc_strategy, strategy>(), name) for every strategy, in the order of the tables
+template <typename Fn>
+void for_each_strategy(Fn&& fn)
+{
+  using cppalloc::alloc_strategy;
+  fn(std::integral_constant<alloc_strategy, alloc_strategy::best_fit>(), "best_fit");
+  fn(std::integral_constant<alloc_strategy, alloc_strategy::best_fit_tree>(), "best_fit_tree");
+  fn(std::integral_constant<alloc_strategy, alloc_strategy::btree>(), "btree");
+  fn(std::integral_constant<alloc_strategy, alloc_strategy::tlsf>(), "tlsf");
+  fn(std::integral_constant<alloc_strategy, alloc_strategy::buddy>(), "buddy");
+}
+} // namespace perf
@@ -1,6 +1,11 @@
+﻿// the handle-checks build overrides CPPALLOC_STALE_HANDLE to throw the handle, see unit_tests/CMakeLists.txt
+#ifdef CPPALLOC_STALE_HANDLE
+#define CPPALLOC_TEST_STALE_HANDLES
+#endif
 #include <catch2/catch.hpp>
 #include <cppalloc.hpp>
 #include <iostream>
+#include <set>
 #include <unordered_set>
 
 struct alloc_mem_manager
@@ -34,6 +39,53 @@ struct alloc_mem_manager
       arenas[l.info.harena][s + l.info.offset] = static_cast<char>(generator(gen));
   }
 
+  //! Allocate a filled block for the next user handle and add it to the valids
+  template <typename Allocator>
+  alloc_info allocate(Allocator& allocator, std::size_t size, std::size_t alignment, cppalloc::alloc_options flags = 0)
+  {
+    cppalloc::alloc_desc<std::size_t> desc(size, alignment, static_cast<cppalloc::uhandle>(allocs.size()), flags);
+    allocs.emplace_back(allocator.allocate(desc), size);
+    fill(allocs.back());
+    valids.push_back(desc.huser());
+    return allocs.back().info;
+  }
+
+  //! Deallocate the block of valids[chosen]
+  template <typename Allocator>
+  void deallocate(Allocator& allocator, std::size_t chosen)
+  {
+    auto handle = valids[chosen];
+    allocator.deallocate(allocs[handle].info.halloc);
+    allocs[handle].size = 0;
+    valids.erase(valids.begin() + chosen);
+  }
+
+  //! Deallocate one of the valids picked at random
+  template <typename Allocator, typename Generator>
+  void deallocate_any(Allocator& allocator, Generator& gen)
+  {
+    deallocate(allocator, std::uniform_int_distribution<std::size_t>(0, valids.size() - 1)(gen));
+  }
+
+  //! Allocate a filled block for a given user handle, outside of the valids
+  template <typename Allocator>
+  alloc_info allocate_as(Allocator& allocator, std::size_t size, cppalloc::uhandle huser)
+  {
+    auto info = allocator.allocate(cppalloc::alloc_desc<std::size_t>(size, 1, huser));
+    allocs.resize(std::max<std::size_t>(allocs.size(), huser + 1));
+    allocs[huser] = allocation(info, size);
+    fill(allocs[huser]);
+    return info;
+  }
+
+  //! Deallocate the block of a user handle, it is rebound when it moves
+  template <typename Allocator>
+  void deallocate_as(Allocator& allocator, cppalloc::uhandle huser)
+  {
+    allocs[huser].size = 0;
+    allocator.deallocate(allocs[huser].info.halloc);
+  }
+
   cppalloc::uhandle add_arena([[maybe_unused]] cppalloc::ihandle id, [[maybe_unused]] std::size_t size)
   {
     arena_data_t arena;
@@ -173,4 +225,1029 @@ TEST_CASE("Validate arena_allocator.best_fit", "[arena_allocator.best_fit]")
     allocator.validate_integrity();
 #endif
   }
-}
\ No newline at end of file
+
+  // free blocks past 4 GiB share the largest search key and are ordered through their sizes
+  using large_allocator_t = cppalloc::arena_allocator<cppalloc::memory_manager_adapter<std::size_t>, std::size_t,
+                                                      cppalloc::alloc_strategy::best_fit, true>;
+  constexpr std::size_t                         k_gib = std::size_t(1) << 30;
+  cppalloc::memory_manager_adapter<std::size_t> large_mgr;
+  large_allocator_t                             large(32 * k_gib, large_mgr);
+  std::vector<cppalloc::ihandle>                handles;
+  for (std::size_t size : {7, 1, 5, 1, 6, 1})
+    handles.push_back(large.allocate(cppalloc::alloc_desc<std::size_t>(size * k_gib, 1, 0)).halloc);
+  for (std::size_t i = 0; i < handles.size(); i += 2)
+    large.deallocate(handles[i]);
+  large.validate_integrity();
+  CHECK(large.allocate(cppalloc::alloc_desc<std::size_t>(6 * k_gib, 1, 0)).offset == 14 * k_gib);
+  CHECK(large.allocate(cppalloc::alloc_desc<std::size_t>(5 * k_gib, 1, 0)).offset == 8 * k_gib);
+  CHECK(large.allocate(cppalloc::alloc_desc<std::size_t>(5 * k_gib + 1, 1, 0)).offset == 0);
+  large.validate_integrity();
+}
+TEST_CASE("Validate arena_allocator.tlsf", "[arena_allocator.tlsf]")
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::tlsf, true>;
+  std::minstd_rand                           gen;
+  std::bernoulli_distribution                dice(0.7);
+  std::uniform_int_distribution<std::size_t> generator(1, 1000);
+  std::uniform_int_distribution<std::size_t> generator2(1, 4);
+  alloc_mem_manager mgr;
+  allocator_t       allocator(920, mgr);
+  for (std::uint32_t allocs = 0; allocs < 10000; ++allocs)
+  {
+    if (dice(gen) || mgr.valids.size() == 0)
+      mgr.allocate(allocator, generator(gen), 1u << generator2(gen), cppalloc::alloc_option_bits::f_defrag);
+    else
+      mgr.deallocate_any(allocator, gen);
+#ifdef CPPALLOC_VALIDITY_CHECKS
+    allocator.validate_integrity();
+#endif
+  }
+
+  // the class of a request just below the arena size starts above it, its arena is sized for the class
+  alloc_mem_manager close;
+  allocator_t       close_allocator(1000, close);
+  auto              info = close_allocator.allocate(cppalloc::alloc_desc<std::size_t>(999, 1, 0));
+  CHECK(info.halloc != allocator_t::null());
+  CHECK(close.arenas.size() == 1);
+  CHECK(close.arenas[0].size() == 1008);
+  close_allocator.validate_integrity();
+}
+
+TEST_CASE("Validate arena_allocator.btree", "[arena_allocator.btree]")
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::btree, true>;
+  std::minstd_rand                           gen;
+  std::bernoulli_distribution                dice(0.7);
+  std::uniform_int_distribution<std::size_t> generator(1, 1000);
+  std::uniform_int_distribution<std::size_t> generator2(1, 4);
+  alloc_mem_manager mgr;
+  allocator_t       allocator(920, mgr);
+  for (std::uint32_t allocs = 0; allocs < 10000; ++allocs)
+  {
+    if (dice(gen) || mgr.valids.size() == 0)
+      mgr.allocate(allocator, generator(gen), 1u << generator2(gen), cppalloc::alloc_option_bits::f_defrag);
+    else
+      mgr.deallocate_any(allocator, gen);
+#ifdef CPPALLOC_VALIDITY_CHECKS
+    allocator.validate_integrity();
+#endif
+  }
+
+  // enough free fragments for the tree to grow several levels, then shrink back to one leaf
+  alloc_mem_manager              fragments;
+  allocator_t                    many(256 * 1024, fragments);
+  std::vector<cppalloc::ihandle> handles;
+  for (cppalloc::uhandle i = 0; i < 8192; ++i)
+    handles.push_back(many.allocate(cppalloc::alloc_desc<std::size_t>(1 + i % 61, 1, i)).halloc);
+  for (std::size_t i = 0; i < handles.size(); i += 2)
+    many.deallocate(handles[i]);
+  many.validate_integrity();
+  auto info = many.allocate(cppalloc::alloc_desc<std::size_t>(61, 1, 0));
+  CHECK(info.offset == 60 * 61 / 2);
+  for (std::size_t i = 1; i < handles.size(); i += 2)
+    many.deallocate(handles[i]);
+  many.validate_integrity();
+}
+
+TEST_CASE("Validate arena_allocator.buddy", "[arena_allocator.buddy]")
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::buddy, true>;
+  std::minstd_rand                           gen;
+  std::bernoulli_distribution                dice(0.7);
+  std::uniform_int_distribution<std::size_t> generator(1, 1000);
+  std::uniform_int_distribution<std::size_t> generator2(1, 4);
+  alloc_mem_manager mgr;
+  allocator_t       allocator(1024, mgr);
+  for (std::uint32_t allocs = 0; allocs < 10000; ++allocs)
+  {
+    if (dice(gen) || mgr.valids.size() == 0)
+      mgr.allocate(allocator, generator(gen), 1u << generator2(gen), cppalloc::alloc_option_bits::f_defrag);
+    else
+      mgr.deallocate_any(allocator, gen);
+#ifdef CPPALLOC_VALIDITY_CHECKS
+    allocator.validate_integrity();
+#endif
+  }
+
+  // blocks are placed at offsets aligned to their rounded size, and released buddies merge back
+  alloc_mem_manager              buddies;
+  allocator_t                    exact(4096, buddies);
+  std::vector<cppalloc::ihandle> handles;
+  for (std::size_t size : {64, 100, 16, 700, 33, 200})
+  {
+    auto info = exact.allocate(cppalloc::alloc_desc<std::size_t>(size, 1, static_cast<cppalloc::uhandle>(size)));
+    CHECK(info.offset % std::bit_ceil(size) == 0);
+    handles.push_back(info.halloc);
+  }
+  for (std::size_t i = 1; i < handles.size(); ++i)
+    exact.deallocate(handles[i]);
+  exact.validate_integrity();
+  auto info = exact.allocate(cppalloc::alloc_desc<std::size_t>(2048, 1, 0));
+  CHECK(info.offset == 2048);
+  CHECK(buddies.arenas.size() == 1);
+
+  // an arena that is not a power of two is cut in the largest aligned pieces, the smallest piece that fits is taken
+  alloc_mem_manager uneven_mgr;
+  allocator_t       uneven(3000, uneven_mgr);
+  CHECK(uneven_mgr.allocate_as(uneven, 1000, 0).offset == 0);
+  CHECK(uneven_mgr.allocate_as(uneven, 300, 1).offset == 2048);
+  CHECK(uneven_mgr.allocate_as(uneven, 100, 2).offset == 2816);
+  CHECK(uneven_mgr.arenas.size() == 1);
+  uneven.validate_integrity();
+
+  // a defragmentation moves the blocks of the sparsest arena into the free pieces of the others
+  alloc_mem_manager sparse_mgr;
+  allocator_t       sparse(1024, sparse_mgr);
+  for (cppalloc::uhandle i = 0; i < 16; ++i)
+    sparse_mgr.allocate_as(sparse, 128, i);
+  CHECK(sparse_mgr.arenas.size() == 2);
+  for (cppalloc::uhandle i : {1, 5, 8, 9, 10, 11, 13, 14})
+    sparse_mgr.deallocate_as(sparse, i);
+  auto plan = sparse.plan_defragment();
+  CHECK(plan.arenas_freed == 1);
+  CHECK(plan.bytes_to_move == 256);
+  CHECK(sparse.apply_plan(std::move(plan)));
+  CHECK(sparse_mgr.arenas[1].empty());
+  CHECK(sparse_mgr.allocs[12].info.harena == 0);
+  sparse.validate_integrity();
+}
+
+TEST_CASE("Validate arena_allocator.defragment_step", "[arena_allocator.defragment_step]")
+{
+  using allocator_t =
+      cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::best_fit_tree, true>;
+  std::minstd_rand                           gen;
+  std::bernoulli_distribution                dice(0.6);
+  std::uniform_int_distribution<std::size_t> generator(1, 1000);
+  std::uniform_int_distribution<std::size_t> generator2(1, 4);
+  alloc_mem_manager                          mgr;
+  allocator_t                                allocator(2048, mgr);
+
+  allocator_t::defrag_budget budget;
+  budget.blocks = 8;
+  for (std::uint32_t allocs = 0; allocs < 4000; ++allocs)
+  {
+    if (dice(gen) || mgr.valids.size() == 0)
+      mgr.allocate(allocator, generator(gen), 1u << generator2(gen));
+    else
+      mgr.deallocate_any(allocator, gen);
+    if (allocs % 16 == 0)
+      allocator.defragment_step(budget);
+  }
+
+  auto live_arenas = [&]() {
+    return std::count_if(mgr.arenas.begin(), mgr.arenas.end(), [](auto const& a) {
+      return !a.empty();
+    });
+  };
+
+  // drain most blocks and compact completely
+  while (mgr.valids.size() > 100)
+    mgr.deallocate_any(allocator, gen);
+  auto arenas = live_arenas();
+  // finish the pass in progress, then run a complete one
+  while (!allocator.defragment_step(budget))
+    ;
+  while (!allocator.defragment_step(budget))
+    ;
+  allocator.validate_integrity();
+  CHECK(live_arenas() < arenas);
+  CHECK(allocator.defragment_step(allocator_t::defrag_budget()));
+
+  // no step moves more bytes than its budget when its first block fits in it
+  for (std::uint32_t allocs = 0; allocs < 1000; ++allocs)
+    mgr.allocate(allocator, generator(gen), 1u << generator2(gen));
+  while (mgr.valids.size() > 300)
+    mgr.deallocate_any(allocator, gen);
+  allocator_t::defrag_budget bytes;
+  bytes.bytes = 1024;
+  for (bool done = false; !done;)
+  {
+    auto moved = allocator.total_bytes_moved;
+    done       = allocator.defragment_step(bytes);
+    CHECK(allocator.total_bytes_moved - moved <= bytes.bytes);
+  }
+  allocator.validate_integrity();
+}
+
+TEST_CASE("Validate arena_allocator.plan_defragment", "[arena_allocator.plan_defragment]")
+{
+  using allocator_t =
+      cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::best_fit_tree, true>;
+  std::minstd_rand                           gen;
+  std::uniform_int_distribution<std::size_t> generator(1, 1000);
+  std::uniform_int_distribution<std::size_t> generator2(1, 4);
+  alloc_mem_manager                          mgr;
+  allocator_t                                allocator(2048, mgr);
+
+  for (std::uint32_t allocs = 0; allocs < 1000; ++allocs)
+    mgr.allocate(allocator, generator(gen), 1u << generator2(gen));
+  while (mgr.valids.size() > 200)
+    mgr.deallocate_any(allocator, gen);
+
+  // a dry run does not touch the allocator
+  auto before = mgr.allocs;
+  auto plan   = allocator.plan_defragment();
+  CHECK(plan.bytes_to_move > 0);
+  CHECK(plan.arenas_freed > 0);
+  CHECK(plan.bytes_reclaimed >= plan.arenas_freed * 2048);
+  CHECK(plan.fragmentation <= allocator.fragmentation());
+  for (std::size_t i = 0; i < before.size(); ++i)
+    CHECK(before[i].info.offset == mgr.allocs[i].info.offset);
+  allocator.validate_integrity();
+
+  // a stale plan is rejected
+  mgr.allocate(allocator, generator(gen), 1u << generator2(gen));
+  CHECK(!allocator.apply_plan(std::move(plan)));
+
+  plan           = allocator.plan_defragment();
+  auto fragments = plan.fragmentation;
+  CHECK(allocator.apply_plan(std::move(plan)));
+  allocator.validate_integrity();
+  CHECK(allocator.fragmentation() == fragments);
+  CHECK(allocator.plan_defragment().bytes_to_move == 0);
+}
+
+TEST_CASE("Validate arena_allocator.plan_evacuation", "[arena_allocator.plan_evacuation]")
+{
+  using allocator_t =
+      cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::best_fit_tree, true>;
+  std::minstd_rand                           gen;
+  std::uniform_int_distribution<std::size_t> generator(1, 400);
+  std::uniform_int_distribution<std::size_t> generator2(1, 4);
+  alloc_mem_manager                          mgr;
+  allocator_t                                allocator(2048, mgr);
+
+  for (std::uint32_t allocs = 0; allocs < 1000; ++allocs)
+    mgr.allocate(allocator, generator(gen), 1u << generator2(gen));
+
+  // empty the arenas unevenly, every 4th one keeps few blocks
+  for (std::size_t i = 0, n = 0; i < mgr.valids.size(); ++n)
+  {
+    auto handle = mgr.valids[i];
+    auto arena  = mgr.allocs[handle].info.harena;
+    if ((arena % 4 == 0 && n % 4 != 0) || (arena % 4 != 0 && n % 8 == 0))
+      mgr.deallocate(allocator, i);
+    else
+      ++i;
+  }
+
+  auto full    = allocator.plan_defragment();
+  auto minimal = allocator.plan_evacuation(0.5f);
+  CHECK(minimal.arenas_freed > 0);
+  CHECK(minimal.bytes_to_move < full.bytes_to_move);
+  CHECK(minimal.bytes_to_move < minimal.bytes_reclaimed);
+
+  auto arenas_freed    = minimal.arenas_freed;
+  auto bytes_reclaimed = minimal.bytes_reclaimed;
+  CHECK(allocator.apply_plan(std::move(minimal)));
+  allocator.validate_integrity();
+  CHECK(allocator.total_arenas_removed == arenas_freed);
+  CHECK(allocator.total_bytes_reclaimed == bytes_reclaimed);
+  CHECK(allocator.total_bytes_moved > 0);
+
+  // nothing sparse is left to evacuate
+  CHECK(allocator.plan_evacuation(0.5f).arenas_freed == 0);
+}
+
+TEST_CASE("Validate arena_allocator.pinned", "[arena_allocator.pinned]")
+{
+  using allocator_t =
+      cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::best_fit_tree, true>;
+  std::minstd_rand                           gen;
+  std::uniform_int_distribution<std::size_t> generator(1, 400);
+  std::uniform_int_distribution<std::size_t> generator2(1, 4);
+  alloc_mem_manager                          mgr;
+  allocator_t                                allocator(2048, mgr);
+
+  for (std::uint32_t allocs = 0; allocs < 1000; ++allocs)
+    mgr.allocate(allocator, generator(gen), 1u << generator2(gen), allocs % 50 == 0 ? cppalloc::f_pinned : 0u);
+  for (std::size_t i = 0; i < mgr.valids.size(); i += 77)
+    allocator.pin(mgr.allocs[mgr.valids[i]].info.halloc);
+
+  for (std::size_t i = 0, n = 0; i < mgr.valids.size(); ++n)
+  {
+    auto handle = mgr.valids[i];
+    if (n % 3 != 0 && !allocator.is_pinned(mgr.allocs[handle].info.halloc))
+      mgr.deallocate(allocator, i);
+    else
+      ++i;
+  }
+
+  std::vector<std::pair<cppalloc::uhandle, alloc_mem_manager::alloc_info>> pinned;
+  for (auto handle : mgr.valids)
+    if (allocator.is_pinned(mgr.allocs[handle].info.halloc))
+      pinned.emplace_back(handle, mgr.allocs[handle].info);
+  REQUIRE(pinned.size() > 10);
+
+  auto check_pinned = [&]() {
+    for (auto const& p : pinned)
+    {
+      auto const& info = mgr.allocs[p.first].info;
+      CHECK(info.harena == p.second.harena);
+      CHECK(info.offset == p.second.offset);
+      CHECK(allocator.is_pinned(info.halloc));
+    }
+  };
+
+  allocator_t::defrag_budget budget;
+  budget.blocks = 8;
+  while (!allocator.defragment_step(budget))
+    ;
+  allocator.validate_integrity();
+  check_pinned();
+
+  CHECK(allocator.apply_plan(allocator.plan_evacuation(0.5f)));
+  allocator.validate_integrity();
+  check_pinned();
+
+  auto plan = allocator.plan_defragment();
+  CHECK(plan.bytes_to_move > 0);
+  CHECK(allocator.apply_plan(std::move(plan)));
+  allocator.validate_integrity();
+  check_pinned();
+
+  // once unpinned, blocks move again
+  for (auto const& p : pinned)
+    allocator.unpin(mgr.allocs[p.first].info.halloc);
+  auto arenas = allocator.plan_defragment().arenas_freed;
+  CHECK(arenas > 0);
+}
+
+TEMPLATE_TEST_CASE_SIG("Validate arena_allocator.plan_defragment_order", "[arena_allocator.plan_defragment_order]",
+                       ((cppalloc::alloc_strategy strategy), strategy), cppalloc::alloc_strategy::best_fit,
+                       cppalloc::alloc_strategy::best_fit_tree, cppalloc::alloc_strategy::tlsf,
+                       cppalloc::alloc_strategy::buddy, cppalloc::alloc_strategy::btree)
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, strategy, true>;
+  std::minstd_rand                           gen;
+  std::uniform_int_distribution<std::size_t> generator(1, 300);
+  std::uniform_int_distribution<std::size_t> generator2(0, 3);
+  std::uniform_int_distribution<std::size_t> dice(0, 9);
+
+  for (std::uint32_t round = 0; round < 200; ++round)
+  {
+    alloc_mem_manager mgr;
+    allocator_t       allocator(1024, mgr);
+    for (std::uint32_t allocs = 0; allocs < 100; ++allocs)
+      mgr.allocate(allocator, generator(gen), 1u << generator2(gen), dice(gen) == 0 ? cppalloc::f_pinned : 0u);
+    for (std::size_t i = 0; i < mgr.valids.size();)
+      if (dice(gen) < 6)
+        mgr.deallocate(allocator, i);
+      else
+        ++i;
+
+    // a block rebuilt in its own arena never lands past its place, over data that is yet to be moved
+    auto plan = allocator.plan_defragment();
+    for (auto const& m : plan.moves)
+      if (m.arena_src == m.arena_dst)
+        CHECK(m.to <= m.from);
+    CHECK(allocator.apply_plan(std::move(plan)));
+    allocator.validate_integrity();
+  }
+}
+
+struct batch_mem_manager : alloc_mem_manager
+{
+  std::uint32_t move_batches   = 0;
+  std::uint32_t rebind_batches = 0;
+  std::size_t   batch_size     = 0;
+
+  void move_memory(std::span<cppalloc::memory_move<std::size_t> const> moves)
+  {
+    move_batches++;
+    batch_size = moves.size();
+    for (auto const& m : moves)
+      alloc_mem_manager::move_memory(m.arena_src, m.arena_dst, m.from, m.to, m.size);
+  }
+
+  void rebind_allocs(std::span<cppalloc::rebind_info<std::size_t> const> rebinds)
+  {
+    rebind_batches++;
+    for (auto const& r : rebinds)
+      rebind_alloc(r.huser, r.info);
+  }
+};
+
+TEST_CASE("Validate arena_allocator.batch_callbacks", "[arena_allocator.batch_callbacks]")
+{
+  using allocator_t =
+      cppalloc::arena_allocator<batch_mem_manager, std::size_t, cppalloc::alloc_strategy::best_fit_tree, true>;
+  static_assert(allocator_t::k_batch_moves && allocator_t::k_batch_rebinds);
+  static_assert(!cppalloc::arena_allocator<alloc_mem_manager>::k_batch_moves);
+
+  std::minstd_rand                           gen;
+  std::uniform_int_distribution<std::size_t> generator(1, 400);
+  std::uniform_int_distribution<std::size_t> generator2(1, 4);
+  batch_mem_manager                          mgr;
+  allocator_t                                allocator(2048, mgr);
+
+  for (std::uint32_t allocs = 0; allocs < 1000; ++allocs)
+    mgr.allocate(allocator, generator(gen), 1u << generator2(gen));
+  for (std::size_t i = 0, n = 0; i < mgr.valids.size(); ++n)
+    if (n % 3 != 0)
+      mgr.deallocate(allocator, i);
+    else
+      ++i;
+
+  auto plan = allocator.plan_evacuation(0.5f);
+  // pairs of arenas are contiguous in a plan
+  std::set<std::pair<cppalloc::uhandle, cppalloc::uhandle>> pairs;
+  for (std::size_t i = 0; i < plan.moves.size(); ++i)
+    if (i == 0 || plan.moves[i].arena_src != plan.moves[i - 1].arena_src ||
+        plan.moves[i].arena_dst != plan.moves[i - 1].arena_dst)
+      CHECK(pairs.emplace(plan.moves[i].arena_src, plan.moves[i].arena_dst).second);
+
+  auto moves         = plan.moves.size();
+  mgr.move_batches   = 0;
+  mgr.rebind_batches = 0;
+  CHECK(allocator.apply_plan(std::move(plan)));
+  allocator.validate_integrity();
+  // every pair of arenas goes in a single batch
+  CHECK(mgr.move_batches == (moves ? 1 : 0));
+  CHECK(mgr.batch_size == moves);
+  CHECK(mgr.rebind_batches == 1);
+
+  mgr.move_batches = 0;
+  plan             = allocator.plan_defragment();
+  moves            = plan.moves.size();
+  CHECK(allocator.apply_plan(std::move(plan)));
+  allocator.validate_integrity();
+  CHECK(mgr.move_batches == (moves ? 1 : 0));
+
+  for (std::size_t i = 1; i < mgr.valids.size(); i += 2)
+  {
+    allocator.deallocate(mgr.allocs[mgr.valids[i]].info.halloc);
+    mgr.allocs[mgr.valids[i]].size = 0;
+  }
+  mgr.move_batches   = 0;
+  mgr.rebind_batches = 0;
+  allocator_t::defrag_budget budget;
+  budget.blocks = 32;
+  while (!allocator.defragment_step(budget))
+    ;
+  allocator.validate_integrity();
+  CHECK(mgr.move_batches > 0);
+  CHECK(mgr.rebind_batches > 0);
+}
+
+TEMPLATE_TEST_CASE_SIG("Validate arena_allocator.placement", "[arena_allocator.placement]",
+                       ((cppalloc::alloc_strategy strategy), strategy), cppalloc::alloc_strategy::best_fit,
+                       cppalloc::alloc_strategy::best_fit_tree, cppalloc::alloc_strategy::btree)
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, strategy>;
+  using alloc_desc  = cppalloc::alloc_desc<std::size_t>;
+  alloc_mem_manager                              mgr;
+  allocator_t                                    allocator(1024, mgr);
+  std::vector<cppalloc::alloc_info<std::size_t>> blocks;
+  for (cppalloc::uhandle i = 0; i < 8; ++i)
+    blocks.push_back(allocator.allocate(alloc_desc(255, 1, i)));
+  CHECK(mgr.arenas.size() == 2);
+
+  allocator.set_placement_candidates(16);
+
+  // the first arena is left half full, the second three quarters full
+  allocator.deallocate(blocks[0].halloc);
+  allocator.deallocate(blocks[2].halloc);
+  allocator.deallocate(blocks[5].halloc);
+  auto info = allocator.allocate(alloc_desc(255, 1, 8));
+  CHECK(info.harena == blocks[5].harena);
+  CHECK(info.offset == blocks[5].offset);
+
+  // so the first one drains and is dropped
+  allocator.deallocate(blocks[1].halloc);
+  allocator.deallocate(blocks[3].halloc);
+  CHECK(mgr.arenas[blocks[0].harena].empty());
+  allocator.validate_integrity();
+}
+
+TEST_CASE("Validate arena_allocator.retention", "[arena_allocator.retention]")
+{
+  using allocator_t =
+      cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::best_fit_tree, true>;
+  using alloc_desc = cppalloc::alloc_desc<std::size_t>;
+  alloc_mem_manager                              mgr;
+  allocator_t                                    allocator(1024, mgr);
+  std::vector<cppalloc::alloc_info<std::size_t>> blocks;
+  allocator.set_arena_retention(1, 4);
+  for (cppalloc::uhandle i = 0; i < 5; ++i)
+    blocks.push_back(allocator.allocate(alloc_desc(255, 1, i)));
+  CHECK(mgr.arenas.size() == 2);
+
+  // the second arena is kept once empty and reused by the next allocation
+  allocator.deallocate(blocks[4].halloc);
+  CHECK(!mgr.arenas[blocks[4].harena].empty());
+  blocks[4] = allocator.allocate(alloc_desc(255, 1, 4));
+  CHECK(mgr.arenas.size() == 2);
+  allocator.deallocate(blocks[4].halloc);
+  CHECK(allocator.total_arenas_retained == 2);
+
+  // until it goes unused for more allocations than allowed
+  allocator.deallocate(blocks[0].halloc);
+  for (cppalloc::uhandle i = 0; i < 5; ++i)
+  {
+    blocks[0] = allocator.allocate(alloc_desc(255, 1, 0));
+    CHECK(blocks[0].harena != blocks[4].harena);
+    allocator.deallocate(blocks[0].halloc);
+  }
+  CHECK(mgr.arenas[blocks[4].harena].empty());
+  CHECK(allocator.total_arenas_expired == 1);
+  allocator.validate_integrity();
+
+  // a newer empty arena takes the place of the older one
+  blocks[0] = allocator.allocate(alloc_desc(255, 1, 0));
+  blocks[4] = allocator.allocate(alloc_desc(255, 1, 4));
+  allocator.set_arena_retention(1);
+  allocator.deallocate(blocks[4].halloc);
+  for (cppalloc::uhandle i = 0; i < 4; ++i)
+    allocator.deallocate(blocks[i].halloc);
+  CHECK(mgr.arenas[blocks[4].harena].empty());
+  CHECK(!mgr.arenas[blocks[0].harena].empty());
+  allocator.validate_integrity();
+}
+
+TEST_CASE("Validate arena_allocator.retention_defragment", "[arena_allocator.retention_defragment]")
+{
+  using allocator_t =
+      cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::best_fit_tree, true>;
+  using alloc_desc = cppalloc::alloc_desc<std::size_t>;
+  alloc_mem_manager mgr;
+  allocator_t       allocator(1024, mgr);
+  allocator.set_arena_growth(allocator_t::arena_growth(1024, 4096));
+  allocator.set_arena_retention(3, 2);
+  for (cppalloc::uhandle i = 0; i < 28; ++i)
+    mgr.allocs.emplace_back(allocator.allocate(alloc_desc(256, 1, i)), 256);
+  REQUIRE(mgr.arenas.size() == 3);
+  REQUIRE(mgr.arenas[2].size() == 4096);
+
+  // the largest arena and then the first are kept once empty
+  for (auto i : {12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 0, 1, 2, 3})
+  {
+    allocator.deallocate(mgr.allocs[i].info.halloc);
+    mgr.allocs[i].size = 0;
+  }
+  CHECK(allocator.total_arenas_retained == 2);
+
+  // the largest one is filled again while still listed, then the bank is rebuilt with new arena ids
+  mgr.allocs.emplace_back(allocator.allocate(alloc_desc(3000, 1, 28)), 3000);
+  mgr.fill(mgr.allocs.back());
+  CHECK(mgr.allocs.back().info.harena == 2);
+  CHECK(allocator.apply_plan(allocator.plan_defragment()));
+  allocator.validate_integrity();
+
+  // retained arenas are expired on later allocations
+  for (cppalloc::uhandle i = 29; i < 33; ++i)
+    mgr.allocs.emplace_back(allocator.allocate(alloc_desc(256, 1, i)), 256);
+  allocator.validate_integrity();
+}
+
+TEST_CASE("Validate arena_allocator.growth", "[arena_allocator.growth]")
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t>;
+  using alloc_desc  = cppalloc::alloc_desc<std::size_t>;
+  alloc_mem_manager              mgr;
+  allocator_t                    allocator(1024, mgr);
+  std::vector<cppalloc::ihandle> blocks;
+  allocator.set_arena_growth(allocator_t::arena_growth(1024, 4096));
+  for (cppalloc::uhandle i = 0; i < 13; ++i)
+    blocks.push_back(allocator.allocate(alloc_desc(255, 1, i)).halloc);
+  REQUIRE(mgr.arenas.size() == 3);
+  CHECK(mgr.arenas[0].size() == 1024);
+  CHECK(mgr.arenas[1].size() == 2048);
+  CHECK(mgr.arenas[2].size() == 4096);
+
+  // a dropped arena shrinks the next one
+  allocator.deallocate(blocks.back());
+  CHECK(mgr.arenas[2].empty());
+  allocator.allocate(alloc_desc(255, 1, 12));
+  CHECK(mgr.arenas.back().size() == 2048);
+  allocator.validate_integrity();
+}
+
+TEST_CASE("Validate arena_allocator.evacuation_order", "[arena_allocator.evacuation_order]")
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t>;
+  alloc_mem_manager mgr;
+  allocator_t       allocator(1024, mgr);
+  allocator.set_arena_growth(allocator_t::arena_growth(1024, 4096));
+  // 64 byte blocks fill arenas of 1024, 2048, 4096 and 4096 bytes
+  for (cppalloc::uhandle i = 0; i < 176; ++i)
+    mgr.allocate(allocator, 64, 1);
+  REQUIRE(mgr.arenas.size() == 4);
+  REQUIRE(mgr.arenas[3].size() == 4096);
+
+  // keep 50% of the first arena (512 bytes), 37.5% of the third (1536 bytes) and leave 1536 bytes at the end of the
+  // last one
+  std::size_t keep[] = {512, 2048, 1536, 2560};
+  for (auto& a : mgr.allocs)
+    if (a.info.offset >= keep[a.info.harena])
+    {
+      allocator.deallocate(a.info.halloc);
+      a.size = 0;
+    }
+
+  // by occupancy the larger third arena is sparser and is the one that fits, by used bytes it would be the first
+  auto plan = allocator.plan_evacuation(0.55f);
+  CHECK(plan.arenas_freed == 1);
+  CHECK(plan.bytes_reclaimed == 4096);
+  CHECK(allocator.apply_plan(std::move(plan)));
+  allocator.validate_integrity();
+  CHECK(mgr.arenas[2].empty());
+  CHECK(!mgr.arenas[0].empty());
+}
+
+TEMPLATE_TEST_CASE_SIG("Validate arena_allocator.resize", "[arena_allocator.resize]",
+                       ((cppalloc::alloc_strategy strategy), strategy), cppalloc::alloc_strategy::best_fit,
+                       cppalloc::alloc_strategy::best_fit_tree, cppalloc::alloc_strategy::btree,
+                       cppalloc::alloc_strategy::tlsf, cppalloc::alloc_strategy::buddy)
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, strategy>;
+  using alloc_desc  = cppalloc::alloc_desc<std::size_t>;
+  alloc_mem_manager mgr;
+  allocator_t       allocator(4096, mgr);
+
+  // an allocation grows over the free space after it and keeps its offset
+  auto a = allocator.allocate(alloc_desc(100, 8, 0));
+  auto b = allocator.allocate(alloc_desc(100, 8, 1));
+  CHECK(!allocator.try_expand(a.halloc, 200));
+  allocator.deallocate(b.halloc);
+  // a buddy block keeps the size of its level
+  constexpr bool k_resizes = strategy != cppalloc::alloc_strategy::buddy;
+  CHECK(allocator.try_expand(a.halloc, 1000) == k_resizes);
+  CHECK(!allocator.try_expand(a.halloc, 4097));
+  allocator.shrink(a.halloc, 50);
+  auto c = allocator.allocate(alloc_desc(100, 8, 1));
+  CHECK(c.harena == a.harena);
+  CHECK(c.offset > a.offset);
+  CHECK(c.offset < 1000);
+  allocator.validate_integrity();
+
+  // the bytes an allocation gains or gives back are counted
+  {
+    using counted_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, strategy, true>;
+    alloc_mem_manager counted_mgr;
+    counted_t         counted(4096, counted_mgr);
+    auto              d      = counted.allocate(alloc_desc(100, 8, 0));
+    auto              before = counted.allocation.load();
+    counted.try_expand(d.halloc, 1000);
+    CHECK((counted.allocation.load() > before) == k_resizes);
+    before = counted.allocation.load();
+    counted.shrink(d.halloc, 50);
+    CHECK((counted.allocation.load() < before) == k_resizes);
+  }
+
+  std::minstd_rand                             gen;
+  std::uniform_int_distribution<std::size_t>  sizes(1, 1000);
+  std::uniform_int_distribution<std::uint32_t> actions(0, 3);
+  std::vector<cppalloc::ihandle>               handles = {a.halloc, c.halloc};
+  for (std::uint32_t i = 0; i < 5000; ++i)
+  {
+    auto action = handles.empty() ? 0 : actions(gen);
+    auto chosen = handles.empty() ? 0 : std::uniform_int_distribution<std::size_t>(0, handles.size() - 1)(gen);
+    if (action == 0)
+      handles.push_back(allocator.allocate(alloc_desc(sizes(gen), 8, i)).halloc);
+    else if (action == 1)
+    {
+      allocator.deallocate(handles[chosen]);
+      handles.erase(handles.begin() + chosen);
+    }
+    else if (action == 2)
+      allocator.try_expand(handles[chosen], sizes(gen) * 2);
+    else
+      allocator.shrink(handles[chosen], sizes(gen) / 2);
+#ifdef CPPALLOC_VALIDITY_CHECKS
+    allocator.validate_integrity();
+#endif
+  }
+  allocator.validate_integrity();
+}
+
+TEMPLATE_TEST_CASE_SIG("Validate arena_allocator.batch", "[arena_allocator.batch]",
+                       ((cppalloc::alloc_strategy strategy), strategy), cppalloc::alloc_strategy::best_fit,
+                       cppalloc::alloc_strategy::best_fit_tree, cppalloc::alloc_strategy::btree,
+                       cppalloc::alloc_strategy::tlsf, cppalloc::alloc_strategy::buddy)
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, strategy>;
+  using alloc_desc  = cppalloc::alloc_desc<std::size_t>;
+  using alloc_info  = cppalloc::alloc_info<std::size_t>;
+  alloc_mem_manager                           mgr;
+  allocator_t                                 allocator(4096, mgr);
+  std::minstd_rand                            gen;
+  std::uniform_int_distribution<std::size_t>  sizes(1, 1000);
+  std::uniform_int_distribution<std::size_t>  alignments(0, 4);
+  std::vector<std::pair<alloc_info, std::size_t>> live;
+  for (std::uint32_t round = 0; round < 50; ++round)
+  {
+    std::vector<alloc_desc> descs;
+    for (std::uint32_t i = 0; i < 64; ++i)
+      descs.emplace_back(sizes(gen), std::size_t(1) << alignments(gen), static_cast<cppalloc::uhandle>(i));
+    std::vector<alloc_info> infos(descs.size());
+    allocator.allocate(descs, infos);
+    for (std::size_t i = 0; i < descs.size(); ++i)
+    {
+      CHECK((infos[i].offset & descs[i].alignment_mask()) == 0);
+      live.emplace_back(infos[i], descs[i].size());
+    }
+
+    // no two allocations overlap
+    auto sorted = live;
+    std::sort(sorted.begin(), sorted.end(), [](auto const& a, auto const& b) {
+      return std::make_pair(a.first.harena, a.first.offset) < std::make_pair(b.first.harena, b.first.offset);
+    });
+    for (std::size_t i = 1; i < sorted.size(); ++i)
+      if (sorted[i].first.harena == sorted[i - 1].first.harena)
+        CHECK(sorted[i - 1].first.offset + sorted[i - 1].second <= sorted[i].first.offset);
+
+    // free about half, neighbours included
+    std::shuffle(live.begin(), live.end(), gen);
+    std::vector<cppalloc::ihandle> handles;
+    for (std::size_t i = live.size() / 2; i < live.size(); ++i)
+      handles.push_back(live[i].first.halloc);
+    live.resize(live.size() / 2);
+    allocator.deallocate(handles);
+    allocator.validate_integrity();
+  }
+
+  std::vector<cppalloc::ihandle> handles;
+  for (auto const& l : live)
+    handles.push_back(l.first.halloc);
+  allocator.deallocate(handles);
+  allocator.validate_integrity();
+  CHECK(std::all_of(mgr.arenas.begin(), mgr.arenas.end(), [](auto const& a) {
+    return a.empty();
+  }));
+}
+
+TEMPLATE_TEST_CASE_SIG("Validate arena_allocator.alignment", "[arena_allocator.alignment]",
+                       ((cppalloc::alloc_strategy strategy), strategy), cppalloc::alloc_strategy::best_fit,
+                       cppalloc::alloc_strategy::best_fit_tree, cppalloc::alloc_strategy::btree,
+                       cppalloc::alloc_strategy::tlsf, cppalloc::alloc_strategy::buddy)
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, strategy>;
+  alloc_mem_manager        mgr;
+  allocator_t              allocator(4096, mgr);
+  std::vector<std::size_t> masks;
+
+  // aligned blocks that are multiples of their alignment fill an arena without padding
+  for (cppalloc::uhandle i = 0; i < 16; ++i)
+  {
+    CHECK(mgr.allocate(allocator, 256, 256).offset % 256 == 0);
+    masks.push_back(255);
+  }
+  CHECK(mgr.arenas.size() == 1);
+
+  std::minstd_rand                           gen;
+  std::uniform_int_distribution<std::size_t> sizes(1, 600);
+  std::uniform_int_distribution<std::size_t> alignments(0, 8);
+  for (std::uint32_t i = 0; i < 3000; ++i)
+  {
+    if (i % 3 == 2)
+    {
+      mgr.deallocate_any(allocator, gen);
+      continue;
+    }
+    auto alignment = std::size_t(1) << alignments(gen);
+    auto info      = mgr.allocate(allocator, sizes(gen), alignment);
+    masks.push_back(alignment - 1);
+    CHECK((info.offset & (alignment - 1)) == 0);
+  }
+  allocator.validate_integrity();
+
+  // moved blocks stay aligned, the manager checks their contents
+  auto aligned = [&]() {
+    return std::all_of(mgr.valids.begin(), mgr.valids.end(), [&](cppalloc::uhandle v) {
+      return (mgr.allocs[v].info.offset & masks[v]) == 0;
+    });
+  };
+  typename allocator_t::defrag_budget budget;
+  budget.blocks = 16;
+  while (!allocator.defragment_step(budget))
+    ;
+  allocator.validate_integrity();
+  CHECK(aligned());
+  CHECK(allocator.apply_plan(allocator.plan_defragment()));
+  allocator.validate_integrity();
+  CHECK(aligned());
+}
+
+TEMPLATE_TEST_CASE_SIG("Validate arena_allocator.front_cache", "[arena_allocator.front_cache]",
+                       ((cppalloc::alloc_strategy strategy), strategy), cppalloc::alloc_strategy::best_fit,
+                       cppalloc::alloc_strategy::best_fit_tree, cppalloc::alloc_strategy::btree,
+                       cppalloc::alloc_strategy::tlsf, cppalloc::alloc_strategy::buddy)
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, strategy>;
+  using alloc_desc  = cppalloc::alloc_desc<std::size_t>;
+  // buddy blocks keep their place in an arena, a defragmentation only empties arenas
+  constexpr bool    k_compacts = strategy != cppalloc::alloc_strategy::buddy;
+  alloc_mem_manager mgr;
+  allocator_t       allocator(1024, mgr);
+  allocator.set_front_cache(8, 256);
+
+  std::vector<cppalloc::alloc_info<std::size_t>> blocks;
+  for (cppalloc::uhandle i = 0; i < 8; ++i)
+    blocks.push_back(mgr.allocate_as(allocator, 128, i));
+  CHECK(mgr.arenas.size() == 1);
+
+  // a released block comes back whole to the next allocation of its size
+  mgr.deallocate_as(allocator, 6);
+  auto info = mgr.allocate_as(allocator, 128, 6);
+  CHECK(info.harena == blocks[6].harena);
+  CHECK(info.offset == blocks[6].offset);
+  allocator.validate_integrity();
+
+  // unless its offset does not meet the alignment
+  mgr.deallocate_as(allocator, 5);
+  CHECK(allocator.try_allocate(alloc_desc(128, 256, 5)).halloc == allocator_t::null());
+  allocator.validate_integrity();
+
+  // cached blocks go back to the free blocks when nothing else fits
+  for (std::size_t i = 0; i < 4; ++i)
+    mgr.deallocate_as(allocator, static_cast<cppalloc::uhandle>(i));
+  info = mgr.allocate_as(allocator, 512, 8);
+  CHECK(mgr.arenas.size() == 1);
+  CHECK(info.offset == 0);
+  allocator.validate_integrity();
+
+  // are seen as free by a defragmentation
+  mgr.deallocate_as(allocator, 7);
+  auto plan = allocator.plan_defragment();
+  CHECK(plan.fragmentation == (k_compacts ? 0.0f : 0.5f));
+  CHECK(allocator.apply_plan(std::move(plan)));
+  allocator.validate_integrity();
+
+  // and leave with the last block in use of their arena
+  mgr.deallocate_as(allocator, 8);
+  mgr.deallocate_as(allocator, 4);
+  allocator.validate_integrity();
+  mgr.deallocate_as(allocator, 6);
+  CHECK(mgr.arenas[0].empty());
+  allocator.validate_integrity();
+
+  // random traffic of a few recurring sizes
+  std::minstd_rand                           gen;
+  std::uniform_int_distribution<std::size_t> sizes(1, 12);
+  std::uniform_int_distribution<std::size_t> alignments(0, 4);
+  allocator.set_front_cache(64, 128);
+  for (std::uint32_t i = 0; i < 3000; ++i)
+  {
+    if (i % 5 >= 3 && !mgr.valids.empty())
+    {
+      mgr.deallocate_any(allocator, gen);
+      continue;
+    }
+    auto alignment = std::size_t(1) << alignments(gen);
+    auto block     = mgr.allocate(allocator, sizes(gen) * 16, alignment, cppalloc::alloc_option_bits::f_defrag);
+    CHECK((block.offset & (alignment - 1)) == 0);
+    if (i % 100 == 0)
+      allocator.validate_integrity();
+  }
+  // the manager checks the contents of the blocks moved
+  CHECK(allocator.apply_plan(allocator.plan_evacuation(0.5f)));
+  allocator.validate_integrity();
+  typename allocator_t::defrag_budget budget;
+  while (!allocator.defragment_step(budget))
+    ;
+  allocator.validate_integrity();
+}
+
+TEMPLATE_TEST_CASE_SIG("Validate arena_allocator.deferred_release", "[arena_allocator.deferred_release]",
+                       ((cppalloc::alloc_strategy strategy), strategy), cppalloc::alloc_strategy::best_fit,
+                       cppalloc::alloc_strategy::best_fit_tree, cppalloc::alloc_strategy::btree,
+                       cppalloc::alloc_strategy::tlsf, cppalloc::alloc_strategy::buddy)
+{
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, strategy>;
+  // buddy blocks keep their place in an arena, a defragmentation only empties arenas
+  constexpr bool    k_compacts = strategy != cppalloc::alloc_strategy::buddy;
+  alloc_mem_manager mgr;
+  allocator_t       allocator(1024, mgr);
+  allocator.set_deferred_release(4);
+
+  // queued blocks are released together once there are enough of them
+  for (cppalloc::uhandle i = 0; i < 4; ++i)
+    mgr.allocate_as(allocator, 128, i);
+  for (cppalloc::uhandle i = 0; i < 3; ++i)
+    mgr.deallocate_as(allocator, i);
+  CHECK(!mgr.arenas[0].empty());
+  allocator.validate_integrity();
+  mgr.deallocate_as(allocator, 3);
+  CHECK(mgr.arenas[0].empty());
+  allocator.validate_integrity();
+
+  // or when an allocation does not fit otherwise
+  for (cppalloc::uhandle i = 0; i < 8; ++i)
+    mgr.allocate_as(allocator, 128, i);
+  CHECK(mgr.arenas.size() == 2);
+  mgr.deallocate_as(allocator, 2);
+  mgr.deallocate_as(allocator, 3);
+  auto info = mgr.allocate_as(allocator, 256, 8);
+  CHECK(mgr.arenas.size() == 2);
+  CHECK(info.offset == 256);
+  CHECK(allocator.fragmentation() == 0.0f);
+  allocator.validate_integrity();
+
+  // and are seen as free by a defragmentation
+  mgr.deallocate_as(allocator, 1);
+  mgr.deallocate_as(allocator, 5);
+  auto plan = allocator.plan_defragment();
+  CHECK(plan.fragmentation == (k_compacts ? 0.0f : 0.5f));
+  CHECK(allocator.apply_plan(std::move(plan)));
+  allocator.validate_integrity();
+  info = mgr.allocate_as(allocator, 256, 9);
+  CHECK(mgr.arenas.size() == (k_compacts ? 2 : 3));
+  CHECK(info.offset == (k_compacts ? 768 : 0));
+  allocator.validate_integrity();
+
+  // random traffic, along with the front cache
+  std::minstd_rand                           gen;
+  std::uniform_int_distribution<std::size_t> sizes(1, 12);
+  std::uniform_int_distribution<std::size_t> alignments(0, 4);
+  allocator.set_deferred_release(32);
+  allocator.set_front_cache(16, 64);
+  for (std::uint32_t i = 0; i < 3000; ++i)
+  {
+    if (i % 5 >= 3 && !mgr.valids.empty())
+    {
+      mgr.deallocate_any(allocator, gen);
+      continue;
+    }
+    auto alignment = std::size_t(1) << alignments(gen);
+    auto block     = mgr.allocate(allocator, sizes(gen) * 16, alignment, cppalloc::alloc_option_bits::f_defrag);
+    CHECK((block.offset & (alignment - 1)) == 0);
+    if (i % 100 == 0)
+      allocator.validate_integrity();
+  }
+  // the manager checks the contents of the blocks moved
+  CHECK(allocator.apply_plan(allocator.plan_evacuation(0.5f)));
+  allocator.validate_integrity();
+  typename allocator_t::defrag_budget budget;
+  while (!allocator.defragment_step(budget))
+    ;
+  allocator.validate_integrity();
+}
+
+TEST_CASE("Validate arena_allocator.block_storage", "[arena_allocator.block_storage]")
+{
+  // an allocator gives back the pages of its blocks once they are empty
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::best_fit>;
+  using alloc_desc  = cppalloc::alloc_desc<std::size_t>;
+  alloc_mem_manager              mgr;
+  allocator_t                    allocator(1024 * 1024, mgr);
+  std::vector<cppalloc::ihandle> handles;
+  allocator.reserve_blocks(4096);
+  for (std::uint32_t i = 0; i < 4096; ++i)
+    handles.push_back(allocator.allocate(alloc_desc(64, 8, i)).halloc);
+  for (std::uint32_t i = 16; i < 4096; ++i)
+    allocator.deallocate(handles[i]);
+  allocator.shrink_to_fit();
+  allocator.validate_integrity();
+  for (std::uint32_t i = 16; i < 4096; ++i)
+    handles[i] = allocator.allocate(alloc_desc(64, 8, i)).halloc;
+  allocator.validate_integrity();
+  allocator.deallocate(handles);
+  allocator.validate_integrity();
+}
+
+#ifdef CPPALLOC_HANDLE_CHECKS
+TEST_CASE("Validate arena_allocator.handles", "[arena_allocator.handles]")
+{
+  // a block that is handed out again gets a new handle, whether it came back through the free blocks or the front
+  // cache
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::best_fit>;
+  using alloc_desc  = cppalloc::alloc_desc<std::size_t>;
+  alloc_mem_manager mgr;
+  allocator_t       allocator(1024, mgr);
+  for (std::uint32_t cached : {0u, 8u})
+  {
+    allocator.set_front_cache(cached);
+    auto a = allocator.allocate(alloc_desc(128, 1, 0));
+    allocator.allocate(alloc_desc(128, 1, 1));
+    allocator.deallocate(a.halloc);
+    auto b = allocator.allocate(alloc_desc(128, 1, 2));
+    CHECK(b.offset == a.offset);
+    CHECK(b.halloc != a.halloc);
+    allocator.deallocate(b.halloc);
+    allocator.validate_integrity();
+  }
+}
+
+#ifdef CPPALLOC_TEST_STALE_HANDLES
+TEST_CASE("Validate arena_allocator.stale_handles", "[arena_allocator.stale_handles]")
+{
+  // a full defragmentation rebinds every block, the handles from before it are stale
+  using allocator_t = cppalloc::arena_allocator<alloc_mem_manager, std::size_t, cppalloc::alloc_strategy::best_fit>;
+  alloc_mem_manager mgr;
+  allocator_t       allocator(1024, mgr);
+  for (std::uint32_t i = 0; i < 8; ++i)
+    mgr.allocate(allocator, 100, 4);
+  mgr.deallocate(allocator, 0);
+  mgr.deallocate(allocator, 3);
+
+  auto stale = mgr.allocs[mgr.valids.back()].info.halloc;
+  CHECK(allocator.apply_plan(allocator.plan_defragment()));
+  allocator.validate_integrity();
+  CHECK(stale != mgr.allocs[mgr.valids.back()].info.halloc);
+  CHECK_THROWS_AS(allocator.deallocate(stale), std::uint32_t);
+  allocator.validate_integrity();
+}
+#endif
+#endif
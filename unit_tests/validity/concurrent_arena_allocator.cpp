@@ -0,0 +1,137 @@
+#include <catch2/catch.hpp>
+#include <cppalloc.hpp>
+#include <memory>
+#include <thread>
+
+struct concurrent_mem_manager
+{
+  using alloc_info = cppalloc::alloc_info<std::size_t>;
+
+  static constexpr std::size_t k_max_arenas = 4096;
+
+  // arenas are never reallocated so threads can touch their memory while others add new ones
+  std::vector<std::unique_ptr<char[]>> arenas;
+  std::size_t                          arena_count = 0;
+
+  concurrent_mem_manager()
+  {
+    arenas.resize(k_max_arenas);
+  }
+
+  bool drop_arena([[maybe_unused]] cppalloc::uhandle id)
+  {
+    arenas[id].reset();
+    return true;
+  }
+
+  cppalloc::uhandle add_arena([[maybe_unused]] cppalloc::ihandle id, std::size_t size)
+  {
+    assert(arena_count < k_max_arenas);
+    arenas[arena_count] = std::make_unique<char[]>(size);
+    return static_cast<cppalloc::uhandle>(arena_count++);
+  }
+
+  void remove_arena(cppalloc::uhandle h)
+  {
+    arenas[h].reset();
+  }
+
+  template <typename Allocator>
+  void begin_defragment(Allocator& allocator)
+  {
+  }
+
+  template <typename Allocator>
+  void end_defragment(Allocator& allocator)
+  {
+  }
+
+  void rebind_alloc([[maybe_unused]] cppalloc::uhandle halloc, alloc_info info) {}
+
+  void move_memory([[maybe_unused]] cppalloc::uhandle src_arena, [[maybe_unused]] cppalloc::uhandle dst_arena,
+                   [[maybe_unused]] std::size_t from, [[maybe_unused]] std::size_t to, std::size_t size)
+  {
+  }
+
+  char* get(alloc_info const& info)
+  {
+    return arenas[info.harena].get() + info.offset;
+  }
+};
+
+TEST_CASE("Validate concurrent_arena_allocator", "[concurrent_arena_allocator]")
+{
+  using allocator_t =
+      cppalloc::concurrent_arena_allocator<concurrent_mem_manager, std::size_t, cppalloc::alloc_strategy::best_fit_tree,
+                                           false, 4>;
+  using alloc_info = allocator_t::alloc_info;
+
+  struct record
+  {
+    alloc_info  info;
+    std::size_t size;
+    char        tag;
+  };
+
+  constexpr std::uint32_t k_thread_count = 8;
+  concurrent_mem_manager  mgr;
+  allocator_t             allocator(4096, mgr);
+  std::atomic_uint32_t    errors = 0;
+
+  auto worker = [&](std::uint32_t thread_id) {
+    std::minstd_rand                           gen(thread_id + 1);
+    std::bernoulli_distribution                dice(0.6);
+    std::uniform_int_distribution<std::size_t> generator(1, 600);
+    std::uniform_int_distribution<std::size_t> generator2(0, 4);
+    std::vector<record>                        records;
+
+    auto check = [&](record const& r) {
+      char* data = mgr.get(r.info);
+      for (std::size_t i = 0; i < r.size; ++i)
+        if (data[i] != r.tag)
+          return false;
+      return true;
+    };
+
+    for (std::uint32_t allocs = 0; allocs < 4000; ++allocs)
+    {
+      if (dice(gen) || records.empty())
+      {
+        record r;
+        r.size     = generator(gen);
+        r.tag      = static_cast<char>('A' + (allocs + thread_id) % 50);
+        auto align = std::size_t(1) << generator2(gen);
+        r.info     = allocator.allocate(cppalloc::alloc_desc<std::size_t>(r.size, align, thread_id));
+        if ((r.info.offset & (align - 1)) != 0)
+          errors++;
+        std::memset(mgr.get(r.info), r.tag, r.size);
+        records.push_back(r);
+      }
+      else
+      {
+        std::uniform_int_distribution<std::size_t> choose(0, records.size() - 1);
+        std::size_t                                chosen = choose(gen);
+        if (!check(records[chosen]))
+          errors++;
+        allocator.deallocate(records[chosen].info.halloc);
+        records.erase(records.begin() + chosen);
+      }
+    }
+
+    for (auto& r : records)
+    {
+      if (!check(r))
+        errors++;
+      allocator.deallocate(r.info.halloc);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (std::uint32_t t = 0; t < k_thread_count; ++t)
+    threads.emplace_back(worker, t);
+  for (auto& t : threads)
+    t.join();
+
+  CHECK(errors.load() == 0);
+  allocator.validate_integrity();
+}
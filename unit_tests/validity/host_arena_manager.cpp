@@ -0,0 +1,64 @@
+#include <catch2/catch.hpp>
+#include <cppalloc.hpp>
+
+TEST_CASE("Validate host_arena_manager", "[host_arena_manager]")
+{
+  using manager_t   = cppalloc::host_arena_manager<std::size_t>;
+  using allocator_t = cppalloc::arena_allocator<manager_t, std::size_t, cppalloc::alloc_strategy::best_fit_tree>;
+  using alloc_info  = allocator_t::alloc_info;
+  static_assert(allocator_t::k_batch_moves);
+
+  struct record
+  {
+    alloc_info  info;
+    std::size_t size = 0;
+    char        tag  = 0;
+  };
+
+  constexpr std::size_t k_arena_size = 4 * 1024 * 1024;
+  for (std::uint32_t threads : {1, 4})
+  {
+    manager_t           mgr(2, threads);
+    allocator_t         allocator(k_arena_size, mgr);
+    std::vector<record> records;
+    mgr.set_rebind_callback([&](cppalloc::uhandle huser, alloc_info const& info) {
+      records[huser].info = info;
+    });
+
+    auto check = [&](record const& r) {
+      auto data = static_cast<char const*>(mgr.resolve(r.info));
+      return std::all_of(data, data + r.size, [&](char c) {
+        return c == r.tag;
+      });
+    };
+
+    // large blocks so moves take the streaming path
+    std::minstd_rand                           gen;
+    std::uniform_int_distribution<std::size_t> generator(1, 600 * 1024);
+    for (std::uint32_t i = 0; i < 64; ++i)
+    {
+      record r;
+      r.size = generator(gen);
+      r.tag  = static_cast<char>('A' + i % 50);
+      r.info = allocator.allocate(cppalloc::alloc_desc<std::size_t>(r.size, 64, i));
+      std::memset(mgr.resolve(r.info), r.tag, r.size);
+      records.push_back(r);
+    }
+    CHECK(reinterpret_cast<std::uintptr_t>(mgr.resolve(records[0].info)) % 64 == 0);
+
+    for (std::size_t i = 0; i < records.size(); i += 2)
+    {
+      allocator.deallocate(records[i].info.halloc);
+      records[i].size = 0;
+    }
+
+    auto mapped = mgr.mapped_size();
+    auto plan   = allocator.plan_defragment();
+    CHECK(plan.arenas_freed > 0);
+    CHECK(allocator.apply_plan(std::move(plan)));
+    allocator.validate_integrity();
+    CHECK(mgr.mapped_size() < mapped);
+    for (auto const& r : records)
+      CHECK(check(r));
+  }
+}
@@ -132,3 +132,15 @@ TEST_CASE("Validate linear_stack_allocator with alignment", "[linear_stack_alloc
   auto a1 = cppalloc::allocate<std::uint8_t*>(allocator, 32, 0);
   CHECK(a1 == first);
 }
+
+TEST_CASE("Validate linear_arena_allocator with arena growth", "[linear_arena_allocator]")
+{
+  using namespace cppalloc;
+  using allocator_t = linear_arena_allocator<default_allocator<std::uint32_t, 0, true>, true>;
+  allocator_t allocator(256);
+  allocator.set_arena_growth(allocator_t::arena_growth(256, 4096));
+  for (std::uint32_t i = 0; i < 40; ++i)
+    cppalloc::allocate<std::uint8_t*>(allocator, 100);
+  // 256, 512, 1024, 2048 and 4096 bytes instead of 20 arenas of 256
+  CHECK(5 == allocator.get_arena_count());
+}
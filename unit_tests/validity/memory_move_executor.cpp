@@ -0,0 +1,43 @@
+#include <catch2/catch.hpp>
+#include <cppalloc.hpp>
+
+TEST_CASE("Validate memory_move_executor", "[memory_move_executor]")
+{
+  using memory_move = cppalloc::memory_move<std::size_t>;
+
+  constexpr std::size_t k_arena_size = 4096;
+  std::minstd_rand      gen;
+
+  std::vector<std::vector<char>> arenas(6, std::vector<char>(k_arena_size));
+  for (auto& arena : arenas)
+    for (auto& c : arena)
+      c = static_cast<char>(gen());
+  auto expected = arenas;
+
+  // random moves, including overlapping ones inside an arena in both directions
+  std::uniform_int_distribution<std::size_t> arena_id(0, arenas.size() - 1);
+  std::uniform_int_distribution<std::size_t> offset(0, k_arena_size - 1);
+  std::vector<memory_move>                   moves;
+  for (std::uint32_t i = 0; i < 2000; ++i)
+  {
+    memory_move m;
+    m.arena_src = arena_id(gen);
+    m.arena_dst = i % 3 == 0 ? m.arena_src : arena_id(gen);
+    m.from      = offset(gen);
+    m.to        = offset(gen);
+    m.size      = std::uniform_int_distribution<std::size_t>(1, k_arena_size - std::max(m.from, m.to))(gen);
+    moves.push_back(m);
+    std::memmove(expected[m.arena_dst].data() + m.to, expected[m.arena_src].data() + m.from, m.size);
+  }
+
+  for (std::uint32_t threads : {1, 4})
+  {
+    auto                                          copy = arenas;
+    cppalloc::memory_move_executor<std::size_t> executor(threads, 64);
+    CHECK(executor.thread_count() == threads);
+    executor.execute(moves, [&](cppalloc::uhandle h) {
+      return copy[h].data();
+    });
+    CHECK(copy == expected);
+  }
+}
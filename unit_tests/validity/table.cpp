@@ -0,0 +1,103 @@
+#include <catch2/catch.hpp>
+#include <cppalloc.hpp>
+#include <random>
+#include <vector>
+
+TEST_CASE("Validate table.pages", "[table.pages]")
+{
+  using table_t = cppalloc::detail::table<std::uint64_t>;
+  constexpr std::uint32_t k_page = 1u << table_t::k_page_bits;
+
+  // elements stay in place while the table grows
+  table_t table;
+  auto    first = table.emplace(7u);
+  auto*   ptr   = &table[first];
+  for (std::uint32_t i = 1; i < 3 * k_page; ++i)
+    CHECK(table.emplace(i) == i);
+  CHECK(&table[first] == ptr);
+  CHECK(*ptr == 7u);
+
+  // erased slots of the lowest page are reused first
+  for (std::uint32_t i = 2 * k_page; i < 3 * k_page; ++i)
+    table.erase(i);
+  table.erase(k_page + 5);
+  table.erase(3);
+  CHECK(table.emplace(0u) == 3);
+  CHECK(table.emplace(0u) == k_page + 5);
+  auto last = table.emplace(0u);
+  CHECK(last >= 2 * k_page);
+
+  // and the last pages are freed once they are empty
+  table.erase(last);
+  for (std::uint32_t i = k_page; i < 2 * k_page; ++i)
+    table.erase(i);
+  table.shrink_to_fit();
+  CHECK(table.end_index() == k_page);
+  CHECK(table.size() == k_page);
+  CHECK(table.emplace(0u) == k_page);
+}
+
+TEST_CASE("Validate table.iteration", "[table.iteration]")
+{
+  using table_t = cppalloc::detail::table<std::uint64_t>;
+  constexpr std::uint32_t k_count = 3 * (1u << table_t::k_page_bits) + 7;
+
+  table_t table;
+  CHECK(table.begin() == table.end());
+
+  std::vector<bool> live(k_count, true);
+  for (std::uint32_t i = 0; i < k_count; ++i)
+    table.emplace(i);
+
+  // whole words, word edges and random slots are erased
+  std::minstd_rand                             gen;
+  std::uniform_int_distribution<std::uint32_t> slot_gen(0, k_count - 1);
+  for (std::uint32_t i = 64; i < 192; ++i)
+    live[i] = false;
+  for (std::uint32_t i : {0u, 63u, 255u, 256u, k_count - 1})
+    live[i] = false;
+  for (std::uint32_t i = 0; i < k_count / 4; ++i)
+    live[slot_gen(gen)] = false;
+  for (std::uint32_t i = 0; i < k_count; ++i)
+    if (!live[i])
+      table.erase(i);
+
+  std::vector<std::uint32_t> expected;
+  for (std::uint32_t i = 0; i < k_count; ++i)
+    if (live[i])
+      expected.push_back(i);
+  std::vector<std::uint32_t> visited(table.begin(), table.end());
+  CHECK(visited == expected);
+  CHECK(visited.size() == table.size());
+  for (auto i : visited)
+    CHECK(table[i] == i);
+  for (std::uint32_t i = 0; i < k_count; ++i)
+    CHECK(table.contains(i) == live[i]);
+
+  for (auto i : expected)
+    table.erase(i);
+  CHECK(table.begin() == table.end());
+}
+
+#ifdef CPPALLOC_HANDLE_CHECKS
+TEST_CASE("Validate table.handles", "[table.handles]")
+{
+  // a slot that is reused gets a new handle, the old one is stale
+  cppalloc::detail::table<std::uint64_t> table;
+  auto                                   first = table.handle(table.emplace(1u));
+  table.erase(table.index(first));
+  auto second = table.handle(table.emplace(2u));
+  CHECK(second >> table.k_generation_bits == first >> table.k_generation_bits);
+  CHECK(second != first);
+  CHECK(!table.is_current(first));
+  CHECK(table.is_current(second));
+
+  // a table rebuilt in place of another does not take the handles the other gave out
+  cppalloc::detail::table<std::uint64_t> rebuilt;
+  rebuilt.supersede(table);
+  auto third = rebuilt.handle(rebuilt.emplace(3u));
+  CHECK(third >> table.k_generation_bits == second >> table.k_generation_bits);
+  CHECK(!rebuilt.is_current(second));
+  CHECK(rebuilt.is_current(third));
+}
+#endif